@@ -31,10 +31,13 @@ int switchtec_handler(const char *optarg, void *value_addr,
 int pax_handler(const char *optarg, void *value_addr,
 		const struct argconfig_options *opt);
 
-#define DEVICE_OPTION \
+#define DEVICE_OPTION DEVICE_OPTION_TYPE(required_positional)
+#define DEVICE_OPTION_OPTIONAL DEVICE_OPTION_TYPE(optional_positional)
+
+#define DEVICE_OPTION_TYPE(type) \
 	{ \
 			"device", .cfg_type=CFG_CUSTOM, .value_addr=&cfg.dev, \
-			.argument_type=required_positional, \
+			.argument_type=type, \
 			.custom_handler=switchtec_handler, \
 			.complete="/dev/switchtec*", \
 			.env="SWITCHTEC_DEV", \
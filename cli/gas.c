@@ -36,6 +36,12 @@
 #include <errno.h>
 #include <ctype.h>
 
+#define READAHEAD_OPTION \
+	{"readahead", 'r', "", CFG_NONE, &cfg.readahead, no_argument, \
+	 "read whole 256 byte blocks through a cache to save transactions " \
+	 "on I2C and UART links; neighbouring registers are read too and " \
+	 "values may be up to 100ms old"}
+
 static void print_line(unsigned long addr, uint8_t *bytes, size_t n)
 {
 	int i;
@@ -284,6 +290,7 @@ static int gas_dump(int argc, char **argv)
 		struct switchtec_dev *dev;
 		int count;
 		int text;
+		int readahead;
 	} cfg = {};
 	const struct argconfig_options opts[] = {
 		DEVICE_OPTION,
@@ -293,6 +300,7 @@ static int gas_dump(int argc, char **argv)
 		 "force outputing data in text format, default is to output in "
 		 "text unless the output is a pipe, in which case binary is "
 		 "output"},
+		READAHEAD_OPTION,
 		{NULL}};
 
 	argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
@@ -306,6 +314,9 @@ static int gas_dump(int argc, char **argv)
 	if (!cfg.count)
 		cfg.count = map_size;
 
+	if (cfg.readahead)
+		switchtec_gas_readahead(cfg.dev, 1);
+
 	if (cfg.text) {
 		hexdump_data(cfg.dev, map, cfg.count, NULL);
 		return 0;
@@ -406,6 +417,7 @@ static int gas_read(int argc, char **argv)
 		unsigned long count;
 		unsigned bytes;
 		unsigned print_style;
+		int readahead;
 	} cfg = {
 		.bytes=4,
 		.count=1,
@@ -421,6 +433,7 @@ static int gas_read(int argc, char **argv)
 		 "number of accesses to perform (default 1)"},
 		{"print", 'p', "STYLE", CFG_CHOICES, &cfg.print_style, required_argument,
 		 "printing style", .choices=print_choices},
+		READAHEAD_OPTION,
 		{NULL}};
 
 	argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
@@ -431,6 +444,9 @@ static int gas_read(int argc, char **argv)
 		return 1;
 	}
 
+	if (cfg.readahead)
+		switchtec_gas_readahead(cfg.dev, 1);
+
 	for (i = 0; i < cfg.count; i++) {
 		ret = print_funcs[cfg.print_style](cfg.dev, map, cfg.addr,
 						   cfg.bytes);
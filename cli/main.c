@@ -32,6 +32,7 @@
 #include <switchtec/switchtec.h>
 #include <switchtec/utils.h>
 #include <switchtec/pci.h>
+#include <switchtec/gas.h>
 
 #include <locale.h>
 #include <time.h>
@@ -39,6 +40,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 
 static struct switchtec_dev *global_dev = NULL;
@@ -646,6 +648,7 @@ static int get_events(struct switchtec_dev *dev,
 		      int index)
 {
 	struct event_list *e = elist;
+	struct switchtec_event_iter it;
 	enum switchtec_event_type type;
 	int flags;
 	int idx;
@@ -654,10 +657,10 @@ static int get_events(struct switchtec_dev *dev,
 
 	local_part = switchtec_partition(dev);
 
-	while (switchtec_event_summary_iter(sum, &e->eid, &idx)) {
-		if (e->eid == SWITCHTEC_EVT_INVALID)
-			continue;
+	switchtec_event_iter_init(&it, sum);
 
+	while (e - elist < elist_len &&
+	       switchtec_event_iter_next(&it, &e->eid, &idx)) {
 		type = switchtec_event_info(e->eid, NULL, NULL);
 
 		if (index >= 0 && index != idx)
@@ -698,13 +701,105 @@ static int get_events(struct switchtec_dev *dev,
 
 		e->count = ret;
 		e++;
-		if (e - elist > elist_len)
-			break;
 	}
 
 	return e - elist;
 }
 
+static void print_event_record(const struct switchtec_event_record *rec,
+			       void *arg)
+{
+	const char *name, *desc;
+	char where[32];
+	char stamp[16];
+	time_t now;
+
+	now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&now));
+
+	if (rec->partition < 0)
+		snprintf(where, sizeof(where), "global");
+	else if (rec->port < 0)
+		snprintf(where, sizeof(where), "part %d", rec->partition);
+	else if (rec->port == SWITCHTEC_PFF_PORT_VEP)
+		snprintf(where, sizeof(where), "part %d vep", rec->partition);
+	else
+		snprintf(where, sizeof(where), "part %d port %d",
+			 rec->partition, rec->port);
+
+	switchtec_event_info(rec->eid, &name, &desc);
+	printf("%s  %-12s  %-16s  %-22s\t%-4u\t%s\n", stamp,
+	       switchtec_name(rec->dev), where, name, rec->count, desc);
+	fflush(stdout);
+}
+
+static int events_follow(struct switchtec_dev *dev, int all_devices,
+			 int show_all)
+{
+	struct switchtec_device_info *devices = NULL;
+	struct switchtec_dev **devs;
+	struct switchtec_monitor *mon;
+	int nr_devs = 1;
+	int ret = -1;
+	int i;
+
+	if (all_devices) {
+		nr_devs = switchtec_list(&devices);
+		if (nr_devs < 0) {
+			perror("list");
+			return nr_devs;
+		}
+
+		if (!nr_devs) {
+			fprintf(stderr, "No switchtec devices found\n");
+			return -1;
+		}
+	}
+
+	devs = calloc(nr_devs, sizeof(*devs));
+	if (!devs) {
+		perror("events");
+		goto out;
+	}
+
+	for (i = 0; i < nr_devs; i++) {
+		if (all_devices) {
+			devs[i] = switchtec_open(strlen(devices[i].path) ?
+						 devices[i].path :
+						 devices[i].name);
+			if (!devs[i]) {
+				switchtec_perror(devices[i].name);
+				goto out;
+			}
+		} else {
+			devs[i] = dev;
+		}
+	}
+
+	mon = switchtec_monitor_new(devs, nr_devs, 0);
+	if (!mon) {
+		switchtec_perror("monitor");
+		goto out;
+	}
+
+	switchtec_monitor_set_local(mon, !show_all);
+
+	while ((ret = switchtec_monitor_run(mon, print_event_record, NULL,
+					    -1)) >= 0)
+		;
+
+	switchtec_perror("monitor");
+	switchtec_monitor_free(mon);
+
+out:
+	for (i = 0; all_devices && devs && i < nr_devs; i++)
+		switchtec_close(devs[i]);
+
+	free(devs);
+	free(devices);
+	return ret;
+}
+
 static int events(int argc, char **argv)
 {
 	const char *desc = "Display information on events that have occurred";
@@ -718,9 +813,11 @@ static int events(int argc, char **argv)
 		int show_all;
 		int clear_all;
 		unsigned event_id;
+		int follow;
+		int all_devices;
 	} cfg = {};
 	const struct argconfig_options opts[] = {
-		DEVICE_OPTION,
+		DEVICE_OPTION_OPTIONAL,
 		{"all", 'a', "", CFG_NONE, &cfg.show_all, no_argument,
 		 "show events in all partitions"},
 		{"reset", 'r', "", CFG_NONE, &cfg.clear_all, no_argument,
@@ -728,11 +825,29 @@ static int events(int argc, char **argv)
 		{"event", 'e', "EVENT", CFG_MULT_CHOICES, &cfg.event_id,
 		  required_argument, .choices=event_choices,
 		  .help="clear all events of a specified type"},
+		{"follow", 'f', "", CFG_NONE, &cfg.follow, no_argument,
+		 "keep running and print (and clear) events as they occur"},
+		{"all-devices", 'A', "", CFG_NONE, &cfg.all_devices,
+		  no_argument,
+		 "with --follow, monitor every switchtec device on this machine"},
 		{NULL}};
 
 	populate_event_choices(event_choices, 1);
 	argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
 
+	if (cfg.all_devices && !cfg.follow) {
+		fprintf(stderr, "--all-devices may only be used with --follow\n");
+		return -1;
+	}
+
+	if (!cfg.dev && !cfg.all_devices) {
+		fprintf(stderr, "A device must be specified\n");
+		return -1;
+	}
+
+	if (cfg.follow)
+		return events_follow(cfg.dev, cfg.all_devices, cfg.show_all);
+
 	ret = switchtec_event_summary(cfg.dev, &sum);
 	if (ret < 0) {
 		perror("event_summary");
@@ -2079,6 +2194,495 @@ static int evcntr_wait(int argc, char **argv)
 	return 0;
 }
 
+enum {
+	BENCH_FMT_TEXT,
+	BENCH_FMT_CSV,
+	BENCH_FMT_JSON,
+};
+
+static const struct argconfig_choice bench_formats[] = {
+	{"text", BENCH_FMT_TEXT, "human readable table"},
+	{"csv", BENCH_FMT_CSV, "comma separated values"},
+	{"json", BENCH_FMT_JSON, "JSON object"},
+	{}
+};
+
+struct bench_ctx {
+	struct switchtec_dev *dev;
+	gasptr_t map;
+	int nr_ports;
+	int phys_port_ids[SWITCHTEC_MAX_PORTS];
+	struct switchtec_bwcntr_res bw_res[SWITCHTEC_MAX_PORTS];
+	uint8_t buf[SWITCHTEC_MRPC_PAYLOAD_SIZE];
+};
+
+static int bench_echo(struct bench_ctx *ctx)
+{
+	uint32_t out;
+
+	return switchtec_echo(ctx->dev, 0xaa55, &out);
+}
+
+static int bench_gas_read32(struct bench_ctx *ctx)
+{
+	gas_read32(ctx->dev, &ctx->map->sys_info.device_id);
+	return 0;
+}
+
+static int bench_memcpy_from_gas(struct bench_ctx *ctx)
+{
+	memcpy_from_gas(ctx->dev, ctx->buf, &ctx->map->mrpc.output_data,
+			sizeof(ctx->buf));
+	return 0;
+}
+
+static int bench_status(struct bench_ctx *ctx)
+{
+	struct switchtec_status *status;
+	int ret;
+
+	ret = switchtec_status(ctx->dev, &status);
+	if (ret < 0)
+		return ret;
+
+	switchtec_status_free(status, ret);
+	return 0;
+}
+
+static int bench_event_summary(struct bench_ctx *ctx)
+{
+	struct switchtec_event_summary sum;
+
+	return switchtec_event_summary(ctx->dev, &sum);
+}
+
+static int bench_bwcntr_many(struct bench_ctx *ctx)
+{
+	int ret;
+
+	ret = switchtec_bwcntr_many(ctx->dev, ctx->nr_ports,
+				    ctx->phys_port_ids, 0, ctx->bw_res);
+
+	return ret < 0 ? ret : 0;
+}
+
+static const struct bench_def {
+	const char *name;
+	int (*fn)(struct bench_ctx *ctx);
+	size_t bytes;
+	int needs_gas;
+} bench_defs[] = {
+	{"echo", bench_echo},
+	{"gas_read32", bench_gas_read32, sizeof(uint32_t), 1},
+	{"memcpy_from_gas", bench_memcpy_from_gas,
+	 SWITCHTEC_MRPC_PAYLOAD_SIZE, 1},
+	{"status", bench_status},
+	{"event_summary", bench_event_summary},
+	{"bwcntr_many", bench_bwcntr_many},
+};
+
+struct bench_result {
+	const struct bench_def *def;
+	double ops_per_sec;
+	uint64_t p50_ns, p99_ns, p999_ns;
+};
+
+static uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t bench_percentile(uint64_t *sorted, unsigned n, double p)
+{
+	unsigned idx = p * n;
+
+	if (idx >= n)
+		idx = n - 1;
+
+	return sorted[idx];
+}
+
+static int bench_run(struct bench_ctx *ctx, const struct bench_def *def,
+		     unsigned iterations, unsigned warmup, uint64_t *samples,
+		     struct bench_result *res)
+{
+	uint64_t start, end, total = 0;
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < warmup; i++) {
+		ret = def->fn(ctx);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		start = bench_now_ns();
+		ret = def->fn(ctx);
+		end = bench_now_ns();
+		if (ret)
+			return ret;
+
+		samples[i] = end - start;
+		total += samples[i];
+	}
+
+	qsort(samples, iterations, sizeof(*samples), bench_cmp_u64);
+
+	res->def = def;
+	res->ops_per_sec = total ? iterations * 1e9 / total : 0;
+	res->p50_ns = bench_percentile(samples, iterations, 0.50);
+	res->p99_ns = bench_percentile(samples, iterations, 0.99);
+	res->p999_ns = bench_percentile(samples, iterations, 0.999);
+
+	return 0;
+}
+
+static double bench_mb_per_sec(struct bench_result *res)
+{
+	return res->def->bytes * res->ops_per_sec / 1e6;
+}
+
+static void bench_print(const char *device, unsigned iterations, int format,
+			struct bench_result *res, int nr_res)
+{
+	int i;
+
+	switch (format) {
+	case BENCH_FMT_TEXT:
+		printf("%s (%u iterations):\n", device, iterations);
+		printf("  %-18s %12s %10s %10s %10s %10s\n", "benchmark",
+		       "ops/s", "p50 (us)", "p99 (us)", "p999 (us)", "MB/s");
+		for (i = 0; i < nr_res; i++) {
+			printf("  %-18s %12.0f %10.2f %10.2f %10.2f",
+			       res[i].def->name, res[i].ops_per_sec,
+			       res[i].p50_ns / 1e3, res[i].p99_ns / 1e3,
+			       res[i].p999_ns / 1e3);
+			if (res[i].def->bytes)
+				printf(" %10.2f", bench_mb_per_sec(&res[i]));
+			printf("\n");
+		}
+		break;
+	case BENCH_FMT_CSV:
+		printf("device,benchmark,iterations,ops_per_sec,p50_ns,"
+		       "p99_ns,p999_ns,mb_per_sec\n");
+		for (i = 0; i < nr_res; i++)
+			printf("%s,%s,%u,%.1f,%" PRIu64 ",%" PRIu64 ",%"
+			       PRIu64 ",%.2f\n", device, res[i].def->name,
+			       iterations, res[i].ops_per_sec, res[i].p50_ns,
+			       res[i].p99_ns, res[i].p999_ns,
+			       bench_mb_per_sec(&res[i]));
+		break;
+	case BENCH_FMT_JSON:
+		printf("{\n  \"device\": \"%s\",\n  \"iterations\": %u,\n"
+		       "  \"results\": [", device, iterations);
+		for (i = 0; i < nr_res; i++)
+			printf("%s\n    {\"benchmark\": \"%s\", "
+			       "\"ops_per_sec\": %.1f, \"p50_ns\": %" PRIu64
+			       ", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %"
+			       PRIu64 ", \"mb_per_sec\": %.2f}",
+			       i ? "," : "", res[i].def->name,
+			       res[i].ops_per_sec, res[i].p50_ns,
+			       res[i].p99_ns, res[i].p999_ns,
+			       bench_mb_per_sec(&res[i]));
+		printf("\n  ]\n}\n");
+		break;
+	}
+}
+
+static int bench(int argc, char **argv)
+{
+	const char *desc = "Measure the cost of common library operations";
+	struct bench_result res[ARRAY_SIZE(bench_defs)];
+	struct switchtec_status *status;
+	struct bench_ctx *ctx;
+	const char *device;
+	char label[256];
+	uint64_t *samples;
+	size_t map_size;
+	int nr_res = 0;
+	int ret = 0;
+	int baud;
+	int i;
+
+	static struct {
+		struct switchtec_dev *dev;
+		unsigned iterations;
+		unsigned warmup;
+		unsigned format;
+		const char *only;
+	} cfg = {
+		.iterations = 1000,
+		.warmup = 10,
+		.format = BENCH_FMT_TEXT,
+	};
+
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"iterations", 'n', "NUM", CFG_POSITIVE, &cfg.iterations,
+		  required_argument,
+		 "number of timed calls per benchmark (default 1000)"},
+		{"warmup", 'w', "NUM", CFG_POSITIVE, &cfg.warmup,
+		  required_argument,
+		 "number of untimed calls before each benchmark (default 10)"},
+		{"format", 'f', "FMT", CFG_CHOICES, &cfg.format,
+		  required_argument, "output format", .choices=bench_formats},
+		{"only", 'o', "NAME", CFG_STRING, &cfg.only, required_argument,
+		 "only run the named benchmark"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
+	device = argv[optind - 1];
+
+	if (!cfg.iterations) {
+		fprintf(stderr, "The --iterations argument must be non-zero\n");
+		return 1;
+	}
+
+	for (i = 0; cfg.only && i < ARRAY_SIZE(bench_defs); i++)
+		if (!strcmp(cfg.only, bench_defs[i].name))
+			break;
+
+	if (i == ARRAY_SIZE(bench_defs)) {
+		fprintf(stderr, "Unknown benchmark: %s\n", cfg.only);
+		return 1;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	samples = calloc(cfg.iterations, sizeof(*samples));
+	if (!ctx || !samples) {
+		perror("bench");
+		ret = -1;
+		goto out;
+	}
+
+	ctx->dev = cfg.dev;
+	ctx->map = switchtec_gas_map(cfg.dev, 0, &map_size);
+	if (ctx->map == SWITCHTEC_MAP_FAILED)
+		ctx->map = NULL;
+
+	ret = switchtec_status(cfg.dev, &status);
+	if (ret < 0) {
+		switchtec_perror("status");
+		goto out;
+	}
+
+	for (i = 0; i < ret && ctx->nr_ports < SWITCHTEC_MAX_PORTS; i++)
+		if (status[i].port.partition == switchtec_partition(cfg.dev))
+			ctx->phys_port_ids[ctx->nr_ports++] =
+				status[i].port.phys_id;
+	switchtec_status_free(status, ret);
+	ret = 0;
+
+	for (i = 0; i < ARRAY_SIZE(bench_defs); i++) {
+		if (cfg.only && strcmp(cfg.only, bench_defs[i].name))
+			continue;
+
+		if (bench_defs[i].needs_gas && !ctx->map) {
+			fprintf(stderr, "%s: skipped, unable to map the GAS\n",
+				bench_defs[i].name);
+			continue;
+		}
+
+		if (bench_run(ctx, &bench_defs[i], cfg.iterations,
+			      cfg.warmup, samples, &res[nr_res])) {
+			switchtec_perror(bench_defs[i].name);
+			ret = 1;
+			continue;
+		}
+
+		nr_res++;
+	}
+
+	baud = switchtec_uart_get_baud(cfg.dev);
+	if (baud > 0) {
+		snprintf(label, sizeof(label), "%s (%d baud)", device, baud);
+		device = label;
+	}
+
+	bench_print(device, cfg.iterations, cfg.format, res, nr_res);
+
+	if (ctx->map)
+		switchtec_gas_unmap(cfg.dev, ctx->map);
+
+out:
+	free(samples);
+	free(ctx);
+	return ret;
+}
+
+static const char * const mrpc_cmd_names[] = {
+	[MRPC_DIAG_PMC_START] = "DIAG_PMC_START",
+	[MRPC_TWI] = "TWI",
+	[MRPC_VGPIO] = "VGPIO",
+	[MRPC_PWM] = "PWM",
+	[MRPC_DIETEMP] = "DIETEMP",
+	[MRPC_FWDNLD] = "FWDNLD",
+	[MRPC_FWLOGRD] = "FWLOGRD",
+	[MRPC_PMON] = "PMON",
+	[MRPC_PORTLN] = "PORTLN",
+	[MRPC_PORTARB] = "PORTARB",
+	[MRPC_MCOVRLY] = "MCOVRLY",
+	[MRPC_STACKBIF] = "STACKBIF",
+	[MRPC_PORTPARTP2P] = "PORTPARTP2P",
+	[MRPC_DIAG_TLP_INJECT] = "DIAG_TLP_INJECT",
+	[MRPC_DIAG_TLP_GEN] = "DIAG_TLP_GEN",
+	[MRPC_DIAG_PORT_EYE] = "DIAG_PORT_EYE",
+	[MRPC_DIAG_POT_VHIST] = "DIAG_POT_VHIST",
+	[MRPC_DIAG_PORT_LTSSM_LOG] = "DIAG_PORT_LTSSM_LOG",
+	[MRPC_DIAG_PORT_TLP_ANL] = "DIAG_PORT_TLP_ANL",
+	[MRPC_DIAG_PORT_LN_ADPT] = "DIAG_PORT_LN_ADPT",
+	[MRPC_SRDS_PCIE_PEAK] = "SRDS_PCIE_PEAK",
+	[MRPC_SRDS_EQ_CTRL] = "SRDS_EQ_CTRL",
+	[MRPC_SRDS_LN_TUNING_MODE] = "SRDS_LN_TUNING_MODE",
+	[MRPC_NT_MCG_CAPABLE_CONFIG] = "NT_MCG_CAPABLE_CONFIG",
+	[MRPC_TCH] = "TCH",
+	[MRPC_ARB] = "ARB",
+	[MRPC_SMBUS] = "SMBUS",
+	[MRPC_RESET] = "RESET",
+	[MRPC_LNKSTAT] = "LNKSTAT",
+	[MRPC_MULTI_CFG] = "MULTI_CFG",
+	[MRPC_SES] = "SES",
+	[MRPC_RD_FLASH] = "RD_FLASH",
+	[MRPC_ECHO] = "ECHO",
+};
+
+static void print_cmd_stats(FILE *f, const char *name,
+			    struct switchtec_cmd_stats *s, int verbose)
+{
+	char sub[12] = "-";
+	uint64_t lo;
+	int i;
+
+	if (s->subcmd >= 0)
+		snprintf(sub, sizeof(sub), "%d", s->subcmd);
+
+	fprintf(f, "  %-20s %4s %9" PRIu64 " %7" PRIu64 " %10" PRIu64
+		" %10" PRIu64 " %10.2f %10.2f\n", name, sub, s->count,
+		s->errors, s->bytes_in, s->bytes_out,
+		s->count ? s->total_ns / 1e3 / s->count : 0,
+		s->max_ns / 1e3);
+
+	if (!verbose)
+		return;
+
+	for (i = 0; i < SWITCHTEC_STATS_HIST_BUCKETS; i++) {
+		if (!s->hist[i])
+			continue;
+
+		lo = 1ULL << i;
+		if (i == SWITCHTEC_STATS_HIST_BUCKETS - 1)
+			fprintf(f, "    >= %8.3g us %9" PRIu64 "\n",
+				lo / 1e3, s->hist[i]);
+		else
+			fprintf(f, "     < %8.3g us %9" PRIu64 "\n",
+				(lo << 1) / 1e3, s->hist[i]);
+	}
+}
+
+static int print_stats(FILE *f, struct switchtec_dev *dev, int verbose)
+{
+	struct switchtec_stats *st;
+	char name[32];
+	int i;
+
+	st = malloc(sizeof(*st));
+	if (!st)
+		return -1;
+
+	switchtec_stats_get(dev, st);
+
+	fprintf(f, "MRPC Statistics:\n");
+	fprintf(f, "  %-20s %4s %9s %7s %10s %10s %10s %10s\n", "Command",
+		"Sub", "Count", "Errors", "Bytes In", "Bytes Out", "Avg (us)",
+		"Max (us)");
+
+	for (i = 0; i < st->nr_cmds; i++) {
+		if (st->cmds[i].cmd < ARRAY_SIZE(mrpc_cmd_names) &&
+		    mrpc_cmd_names[st->cmds[i].cmd])
+			snprintf(name, sizeof(name), "%s",
+				 mrpc_cmd_names[st->cmds[i].cmd]);
+		else
+			snprintf(name, sizeof(name), "0x%x", st->cmds[i].cmd);
+
+		print_cmd_stats(f, name, &st->cmds[i], verbose);
+	}
+
+	print_cmd_stats(f, "Total", &st->total, verbose);
+
+	if (st->untracked)
+		fprintf(f, "  (%" PRIu64 " calls only counted in the total)\n",
+			st->untracked);
+
+	free(st);
+	return 0;
+}
+
+static int stats(int argc, char **argv)
+{
+	const char *desc = "Display MRPC statistics for a set of monitoring "
+		"queries\n\n"
+		"This issues the commands that status, events and temp use "
+		"the given number of times and shows what each MRPC cost. "
+		"Any other command can report the same table on exit by "
+		"setting the SWITCHTEC_STATS environment variable.";
+	struct switchtec_event_summary sum;
+	struct switchtec_status *status;
+	int ret;
+	unsigned i;
+
+	static struct {
+		struct switchtec_dev *dev;
+		unsigned count;
+		int verbose;
+	} cfg = {
+		.count = 1,
+	};
+
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"count", 'n', "NUM", CFG_POSITIVE, &cfg.count,
+		  required_argument,
+		 "number of times to run the queries (default 1)"},
+		{"verbose", 'v', "", CFG_NONE, &cfg.verbose, no_argument,
+		 "print a latency histogram for each command"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
+
+	switchtec_stats_reset(cfg.dev);
+
+	for (i = 0; i < cfg.count; i++) {
+		ret = switchtec_status(cfg.dev, &status);
+		if (ret < 0) {
+			switchtec_perror("status");
+			return ret;
+		}
+		switchtec_status_free(status, ret);
+
+		ret = switchtec_event_summary(cfg.dev, &sum);
+		if (ret < 0) {
+			switchtec_perror("event summary");
+			return ret;
+		}
+
+		switchtec_die_temp(cfg.dev);
+	}
+
+	return print_stats(stdout, cfg.dev, cfg.verbose);
+}
+
 static const struct cmd commands[] = {
 	CMD(list, "List all switchtec devices on this machine"),
 	CMD(info, "Display information for a Switchtec device"),
@@ -2107,6 +2711,8 @@ static const struct cmd commands[] = {
 	CMD(evcntr_show, "Show an event counters setup info"),
 	CMD(evcntr_del, "Deconfigure an event counter"),
 	CMD(evcntr_wait, "Wait for an event counter to exceed its threshold"),
+	CMD(bench, "Measure the cost of common library operations"),
+	CMD(stats, "Display MRPC statistics for a set of monitoring queries"),
 	{},
 };
 
@@ -2144,6 +2750,10 @@ int main(int argc, char **argv)
 
 	ret = commands_handle(argc, argv, &prog_info);
 
+	if (global_dev && getenv("SWITCHTEC_STATS"))
+		print_stats(stderr, global_dev,
+			    !strcmp(getenv("SWITCHTEC_STATS"), "verbose"));
+
 	switchtec_close(global_dev);
 
 	return ret;
@@ -0,0 +1,326 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Exercises the per-handle MRPC command queue, the asynchronous command
+ * API and the event journal against the simulated device, so it needs
+ * no hardware. Run it with "make check"; it exits non-zero if anything
+ * goes wrong.
+ */
+
+#include <switchtec/switchtec.h>
+#include <switchtec/mrpc.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define NR_THREADS		8
+#define CMDS_PER_THREAD		2000
+#define NR_EVENTS		20000
+#define JOURNAL_ENTRIES		64
+
+static int failures;
+
+static void fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "FAIL: ");
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+
+	__atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+}
+
+struct echo_thread {
+	pthread_t thread;
+	struct switchtec_dev *dev;
+	int id;
+};
+
+static void *echo_thread(void *arg)
+{
+	struct echo_thread *t = arg;
+	uint32_t in, out;
+	int i, ret;
+
+	for (i = 0; i < CMDS_PER_THREAD; i++) {
+		in = (t->id << 24) | i;
+		out = 0;
+
+		ret = switchtec_echo(t->dev, in, &out);
+		if (ret) {
+			fail("thread %d: echo returned %d (errno %d)",
+			     t->id, ret, errno);
+			break;
+		}
+
+		if (out != ~in) {
+			fail("thread %d: echo of %08x returned %08x",
+			     t->id, in, out);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/* Many threads issuing commands on one handle must each get their own reply */
+static void test_cmd_threads(struct switchtec_dev *dev)
+{
+	struct echo_thread t[NR_THREADS];
+	int i;
+
+	for (i = 0; i < NR_THREADS; i++) {
+		t[i].dev = dev;
+		t[i].id = i;
+		if (pthread_create(&t[i].thread, NULL, echo_thread, &t[i])) {
+			fail("pthread_create");
+			return;
+		}
+	}
+
+	for (i = 0; i < NR_THREADS; i++)
+		pthread_join(t[i].thread, NULL);
+
+	printf("  %d threads x %d commands\n", NR_THREADS, CMDS_PER_THREAD);
+}
+
+struct async_peer {
+	struct switchtec_dev *dev;
+	int poll_ret, poll_errno;
+	int echo_ret;
+	uint32_t echo_out;
+	int done;
+};
+
+static void *async_peer(void *arg)
+{
+	struct async_peer *p = arg;
+
+	p->poll_ret = switchtec_cmd_poll(p->dev, 0);
+	p->poll_errno = errno;
+
+	/* Waits until the owner completes its command */
+	p->echo_ret = switchtec_echo(p->dev, 0x1234, &p->echo_out);
+	__atomic_store_n(&p->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/*
+ * The submitting thread owns the MRPC until it completes the command:
+ * it gets EBUSY for anything else it issues, other threads can't poll
+ * its command and their own commands wait their turn.
+ */
+static void test_async(struct switchtec_dev *dev)
+{
+	struct async_peer p = {
+		.dev = dev,
+	};
+	uint32_t in = 0xa5a5f00d, out = 0;
+	pthread_t thread;
+	int ret;
+
+	ret = switchtec_cmd_submit(dev, MRPC_ECHO, &in, sizeof(in));
+	if (ret) {
+		fail("cmd_submit returned %d (errno %d)", ret, errno);
+		return;
+	}
+
+	ret = switchtec_echo(dev, 0, &out);
+	if (ret >= 0 || errno != EBUSY)
+		fail("command from the owner returned %d (errno %d), "
+		     "expected EBUSY", ret, errno);
+
+	ret = switchtec_cmd_submit(dev, MRPC_ECHO, &in, sizeof(in));
+	if (ret >= 0 || errno != EBUSY)
+		fail("second submit returned %d (errno %d), expected EBUSY",
+		     ret, errno);
+
+	if (pthread_create(&thread, NULL, async_peer, &p)) {
+		fail("pthread_create");
+		switchtec_cmd_complete(dev, &out, sizeof(out));
+		return;
+	}
+
+	usleep(50000);
+	if (__atomic_load_n(&p.done, __ATOMIC_ACQUIRE))
+		fail("another thread's command ran while the MRPC was owned");
+
+	ret = switchtec_cmd_complete(dev, &out, sizeof(out));
+	if (ret)
+		fail("cmd_complete returned %d (errno %d)", ret, errno);
+	else if (out != ~in)
+		fail("async echo of %08x returned %08x", in, out);
+
+	pthread_join(thread, NULL);
+
+	if (p.poll_ret >= 0 || p.poll_errno != EINVAL)
+		fail("poll from another thread returned %d (errno %d), "
+		     "expected EINVAL", p.poll_ret, p.poll_errno);
+
+	if (p.echo_ret)
+		fail("waiting thread's echo returned %d", p.echo_ret);
+	else if (p.echo_out != ~0x1234U)
+		fail("waiting thread's echo returned %08x", p.echo_out);
+
+	ret = switchtec_echo(dev, in, &out);
+	if (ret || out != ~in)
+		fail("echo after cmd_complete returned %d", ret);
+
+	printf("  async ownership\n");
+}
+
+struct journal_producer {
+	struct switchtec_dev *dev;
+	struct switchtec_monitor *mon;
+	int finished;
+};
+
+static void *journal_producer(void *arg)
+{
+	struct journal_producer *p = arg;
+	int i, ret;
+
+	for (i = 0; i < NR_EVENTS; i++) {
+		switchtec_sim_raise_event(p->dev, SWITCHTEC_PFF_EVT_LINK_STATE,
+					  1);
+
+		ret = switchtec_monitor_run(p->mon, NULL, NULL, 0);
+		if (ret != 1) {
+			fail("monitor_run returned %d (errno %d)", ret, errno);
+			break;
+		}
+
+		/* Give the reader a chance on a single CPU */
+		if (!(i % 16))
+			sched_yield();
+	}
+
+	__atomic_store_n(&p->finished, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/*
+ * One thread runs the monitor and fills a small journal while another
+ * drains it. Every event must come out once, in order, or be counted
+ * as dropped.
+ */
+static void test_journal(struct switchtec_dev *dev)
+{
+	struct journal_producer p = {
+		.dev = dev,
+	};
+	struct switchtec_journal *journal;
+	struct switchtec_journal_entry entry;
+	uint64_t last_ns = 0;
+	unsigned long entries = 0, dropped, dropped_before;
+	pthread_t thread;
+	int finished;
+
+	journal = switchtec_journal_new(JOURNAL_ENTRIES);
+	p.mon = switchtec_monitor_new(&dev, 1, 0);
+	if (!journal || !p.mon) {
+		fail("journal or monitor allocation");
+		goto out;
+	}
+
+	switchtec_monitor_set_journal(p.mon, journal);
+
+	/* Flush out what earlier commands left pending */
+	switchtec_monitor_run(p.mon, NULL, NULL, 0);
+	while (switchtec_journal_next(journal, &entry))
+		;
+	dropped_before = switchtec_journal_dropped(journal);
+
+	if (pthread_create(&thread, NULL, journal_producer, &p)) {
+		fail("pthread_create");
+		goto out;
+	}
+
+	do {
+		finished = __atomic_load_n(&p.finished, __ATOMIC_ACQUIRE);
+
+		while (switchtec_journal_next(journal, &entry)) {
+			if (entry.rec.eid != SWITCHTEC_PFF_EVT_LINK_STATE ||
+			    entry.rec.index != 1 || entry.rec.count != 1)
+				fail("journal entry %lu: event %d index %d "
+				     "count %u", entries, entry.rec.eid,
+				     entry.rec.index, entry.rec.count);
+
+			if (entry.timestamp_ns < last_ns)
+				fail("journal entry %lu went back in time",
+				     entries);
+
+			last_ns = entry.timestamp_ns;
+			entries++;
+		}
+	} while (!finished);
+
+	pthread_join(thread, NULL);
+
+	dropped = switchtec_journal_dropped(journal) - dropped_before;
+	if (entries + dropped != NR_EVENTS)
+		fail("journal returned %lu entries and dropped %lu of %d",
+		     entries, dropped, NR_EVENTS);
+
+	printf("  journal: %lu events read, %lu dropped\n", entries, dropped);
+
+out:
+	switchtec_monitor_free(p.mon);
+	switchtec_journal_free(journal);
+}
+
+int main(void)
+{
+	struct switchtec_dev *dev;
+
+	dev = switchtec_open_sim(16);
+	if (!dev) {
+		switchtec_perror("sim");
+		return 1;
+	}
+
+	test_cmd_threads(dev);
+	test_async(dev);
+	test_journal(dev);
+
+	switchtec_close(dev);
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+
+	printf("ok\n");
+	return 0;
+}
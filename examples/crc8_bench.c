@@ -0,0 +1,77 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measures the throughput of the library's internal crc8() used for
+ * the I2C PEC and the UART console CRC. It uses a library-internal
+ * symbol so it links against the static library; build and run it
+ * with "make bench-crc8".
+ */
+
+#include "lib/crc8.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned sizes[] = {8, 34, 100, 1024};
+	unsigned iterations = 1000000;
+	uint8_t buf[1024];
+	uint64_t start, ns;
+	uint8_t crc = 0;
+	unsigned i, j;
+
+	if (argc > 1)
+		iterations = strtoul(argv[1], NULL, 0);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = rand();
+
+	printf("  %6s %10s %10s\n", "bytes", "ns/call", "MB/s");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		start = now_ns();
+		for (j = 0; j < iterations; j++)
+			crc = crc8(buf, sizes[i], crc, false);
+		ns = now_ns() - start;
+
+		printf("  %6u %10.1f %10.1f\n", sizes[i],
+		       (double)ns / iterations,
+		       (double)sizes[i] * iterations * 1000 / ns);
+	}
+
+	/* Keep the result live so the loop isn't optimized away */
+	return crc == 0x100;
+}
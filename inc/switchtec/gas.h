@@ -64,6 +64,22 @@
 
 #include <stdint.h>
 
+/**
+ * @brief A single read in a batch passed to gas_read_batch()
+ */
+struct gas_read_req {
+	const void __gas *addr;	//!< GAS address to read from
+	void *dest;		//!< Buffer to place the data in
+	size_t len;		//!< Number of bytes to read
+};
+
+/**
+ * @brief Initializer for a gas_read_req reading a register into a variable
+ *	of the same width
+ */
+#define GAS_READ_REQ(reg, var) \
+	{.addr = (reg), .dest = (var), .len = sizeof(*(var))}
+
 void memcpy_to_gas(struct switchtec_dev *dev, void __gas *dest,
 		   const void *src, size_t n);
 
@@ -73,6 +89,9 @@ void memcpy_from_gas(struct switchtec_dev *dev, void *dest,
 ssize_t write_from_gas(struct switchtec_dev *dev, int fd,
 		       const void __gas *src, size_t n);
 
+void gas_read_batch(struct switchtec_dev *dev,
+		    const struct gas_read_req *reqs, size_t n);
+
 uint8_t gas_read8(struct switchtec_dev *dev, uint8_t __gas *addr);
 uint16_t gas_read16(struct switchtec_dev *dev, uint16_t __gas *addr);
 uint32_t gas_read32(struct switchtec_dev *dev, uint32_t __gas *addr);
@@ -52,6 +52,7 @@ struct switchtec_dev;
 #define SWITCHTEC_MAX_EVENT_COUNTERS 64
 #define SWITCHTEC_UNBOUND_PORT 255
 #define SWITCHTEC_PFF_PORT_VEP 100
+#define SWITCHTEC_UART_BAUD_AUTO -1
 
 #define SWITCHTEC_FLASH_BOOT_PART_START 0xa8000000
 #define SWITCHTEC_FLASH_MAP0_PART_START 0xa8020000
@@ -98,6 +99,67 @@ enum switchtec_variant {
 	SWITCHTEC_VAR_UNKNOWN,
 };
 
+/**
+ * @brief Policies for waiting on MRPC command completion
+ * @see switchtec_set_mrpc_poll_policy()
+ *
+ * These only apply to platforms that poll the MRPC registers directly
+ * (ie. I2C and UART). The Linux and Windows drivers wait for the
+ * completion interrupt themselves.
+ */
+enum switchtec_mrpc_poll_policy {
+	/** Spin briefly then back off exponentially (the default) */
+	SWITCHTEC_MRPC_POLL_BALANCED,
+	/** Spin longer and keep sleeps short for the lowest latency */
+	SWITCHTEC_MRPC_POLL_LATENCY,
+	/** Sleep through most of the expected latency and poll rarely */
+	SWITCHTEC_MRPC_POLL_LOW_CPU,
+};
+
+/**
+ * @brief A buffer segment for scatter/gather MRPC commands
+ *
+ * See switchtec_cmdv(). Mirrors struct iovec so callers can describe a
+ * command header and its data without first packing them together.
+ */
+struct switchtec_iovec {
+	void *iov_base;		//!< Start of the segment
+	size_t iov_len;		//!< Length of the segment in bytes
+};
+
+#define SWITCHTEC_STATS_HIST_BUCKETS 32
+#define SWITCHTEC_STATS_MAX_CMDS 64
+
+/**
+ * @brief MRPC statistics for one command/sub-command pair
+ *
+ * Histogram bucket n counts the calls that took from 2^n up to
+ * 2^(n+1) - 1 nanoseconds; the last bucket also counts anything longer.
+ */
+struct switchtec_cmd_stats {
+	int cmd;		//!< MRPC command ID, -1 for the totals
+	int subcmd;		//!< Sub-command, or -1 if it has none
+	uint64_t count;		//!< Number of calls
+	uint64_t errors;	//!< Calls that returned non-zero
+	uint64_t bytes_in;	//!< Payload bytes sent to the switch
+	uint64_t bytes_out;	//!< Response bytes read back
+	uint64_t total_ns;	//!< Sum of all call latencies
+	uint64_t max_ns;	//!< Slowest call
+	uint64_t hist[SWITCHTEC_STATS_HIST_BUCKETS]; //!< Latency histogram
+};
+
+/**
+ * @brief MRPC statistics for a device handle
+ * @see switchtec_stats_get()
+ */
+struct switchtec_stats {
+	struct switchtec_cmd_stats total;	//!< All commands combined
+	uint64_t untracked;	//!< Calls only counted in the totals
+				//!< because \p cmds was full
+	int nr_cmds;		//!< Number of valid entries in \p cmds
+	struct switchtec_cmd_stats cmds[SWITCHTEC_STATS_MAX_CMDS];
+};
+
 /**
  * @brief Represents a Switchtec device in the switchtec_list() function
  */
@@ -258,6 +320,16 @@ enum switchtec_event_id {
 	SWITCHTEC_MAX_EVENTS,
 };
 
+/**
+ * @brief Transfer parameters in use on an I2C attached switch
+ */
+struct switchtec_i2c_info {
+	unsigned max_read;	//!< Largest GAS read per I2C transaction (fixed)
+	unsigned max_write;	//!< Largest GAS write per I2C transaction (fixed)
+	unsigned pipeline;	//!< GAS transfers issued per I2C_RDWR ioctl
+	unsigned write_window;	//!< GAS writes sent per I2C_RDWR ioctl
+};
+
 /*********** Platform Functions ***********/
 
 struct switchtec_dev *switchtec_open(const char *device);
@@ -267,7 +339,19 @@ struct switchtec_dev *switchtec_open_by_pci_addr(int domain, int bus,
 						 int device, int func);
 struct switchtec_dev *switchtec_open_i2c(const char *path, int i2c_addr);
 struct switchtec_dev *switchtec_open_i2c_by_adapter(int adapter, int i2c_addr);
+int switchtec_i2c_get_info(struct switchtec_dev *dev,
+			   struct switchtec_i2c_info *info);
+int switchtec_i2c_set_write_window(struct switchtec_dev *dev, int window);
 struct switchtec_dev *switchtec_open_uart(int fd);
+struct switchtec_dev *switchtec_open_uart_baud(int fd, int baud);
+struct switchtec_dev *switchtec_open_uart_by_path(const char *path,
+						  int baud);
+int switchtec_uart_get_baud(struct switchtec_dev *dev);
+struct switchtec_dev *switchtec_open_sim(int nr_ports);
+int switchtec_sim_set_latency(struct switchtec_dev *dev, int cmd,
+			      unsigned latency_us);
+int switchtec_sim_raise_event(struct switchtec_dev *dev,
+			      enum switchtec_event_id e, int index);
 
 void switchtec_close(struct switchtec_dev *dev);
 int switchtec_list(struct switchtec_device_info **devlist);
@@ -276,6 +360,15 @@ int switchtec_get_fw_version(struct switchtec_dev *dev, char *buf,
 int switchtec_cmd(struct switchtec_dev *dev, uint32_t cmd,
 		  const void *payload, size_t payload_len, void *resp,
 		  size_t resp_len);
+int switchtec_cmdv(struct switchtec_dev *dev, uint32_t cmd,
+		   const struct switchtec_iovec *payload, int payload_cnt,
+		   const struct switchtec_iovec *resp, int resp_cnt);
+int switchtec_cmd_submit(struct switchtec_dev *dev, uint32_t cmd,
+			 const void *payload, size_t payload_len);
+int switchtec_cmd_poll(struct switchtec_dev *dev, int timeout_ms);
+int switchtec_cmd_complete(struct switchtec_dev *dev, void *resp,
+			   size_t resp_len);
+int switchtec_cmd_fd(struct switchtec_dev *dev);
 int switchtec_get_devices(struct switchtec_dev *dev,
 			  struct switchtec_status *status,
 			  int ports);
@@ -305,6 +398,14 @@ _PURE int switchtec_device_id(struct switchtec_dev *dev);
 _PURE enum switchtec_gen switchtec_gen(struct switchtec_dev *dev);
 _PURE enum switchtec_variant switchtec_variant(struct switchtec_dev *dev);
 int switchtec_set_pax_id(struct switchtec_dev *dev, int pax_id);
+int switchtec_set_mrpc_poll_policy(struct switchtec_dev *dev,
+				   enum switchtec_mrpc_poll_policy policy);
+int switchtec_stats_get(struct switchtec_dev *dev,
+			struct switchtec_stats *stats);
+void switchtec_stats_reset(struct switchtec_dev *dev);
+int switchtec_cache_enable(struct switchtec_dev *dev, unsigned ttl_ms);
+void switchtec_cache_disable(struct switchtec_dev *dev);
+void switchtec_cache_invalidate(struct switchtec_dev *dev);
 int switchtec_echo(struct switchtec_dev *dev, uint32_t input, uint32_t *output);
 int switchtec_hard_reset(struct switchtec_dev *dev);
 int switchtec_status(struct switchtec_dev *dev,
@@ -466,6 +567,69 @@ enum switchtec_event_type {
 	SWITCHTEC_EVT_PFF,
 };
 
+/**
+ * @brief One entry in a set of events passed to switchtec_event_wait_set()
+ */
+struct switchtec_event_wait_item {
+	enum switchtec_event_id e;	//!< Event ID to wait for
+	int index;		//!< Partition or port index, or a special index
+	int fired;		//!< Set on return if this event occurred
+};
+
+/**
+ * @brief An (event, index) pair from switchtec_event_summary_decode()
+ */
+struct switchtec_event_pair {
+	enum switchtec_event_id e;	//!< Event ID
+	int index;		//!< Partition or port function index
+};
+
+/**
+ * @brief Cursor over the events set in a summary
+ * @see switchtec_event_iter_init()
+ *
+ * The members are private to the library.
+ */
+struct switchtec_event_iter {
+	const struct switchtec_event_summary *sum;
+	int word;
+	int next_word;
+	uint64_t bits;
+};
+
+/**
+ * @brief An event reported by switchtec_monitor_run()
+ */
+struct switchtec_event_record {
+	struct switchtec_dev *dev;	//!< Device the event occurred on
+	int dev_idx;		//!< Index of the device in the monitored set
+	enum switchtec_event_id eid;	//!< Event ID
+	int index;		//!< Partition or port function index
+	int partition;		//!< Partition, or -1 for global events
+	int port;		//!< Port, or -1 for global and partition events
+	unsigned count;		//!< Occurrences since the event was cleared
+	uint32_t data[5];	//!< Event data words, as from switchtec_event_ctl()
+};
+
+/**
+ * @brief Callback invoked by switchtec_monitor_run() for each event
+ */
+typedef void (*switchtec_monitor_fn)(const struct switchtec_event_record *rec,
+				     void *arg);
+
+struct switchtec_monitor;
+
+/**
+ * @brief An entry in an event journal
+ * @see switchtec_journal_next()
+ */
+struct switchtec_journal_entry {
+	uint64_t timestamp_ns;	//!< CLOCK_MONOTONIC time the event was cleared
+	struct switchtec_event_record rec;	//!< The event itself
+};
+
+struct switchtec_journal;
+
 int switchtec_event_summary_set(struct switchtec_event_summary *sum,
 				enum switchtec_event_id e,
 				int index);
@@ -475,6 +639,13 @@ int switchtec_event_summary_test(struct switchtec_event_summary *sum,
 int switchtec_event_summary_iter(struct switchtec_event_summary *sum,
 				 enum switchtec_event_id *e,
 				 int *idx);
+void switchtec_event_iter_init(struct switchtec_event_iter *it,
+			       const struct switchtec_event_summary *sum);
+int switchtec_event_iter_next(struct switchtec_event_iter *it,
+			      enum switchtec_event_id *e, int *idx);
+int switchtec_event_summary_decode(const struct switchtec_event_summary *sum,
+				   struct switchtec_event_pair *pairs,
+				   int max_pairs);
 enum switchtec_event_type switchtec_event_info(enum switchtec_event_id e,
 					       const char **name,
 					       const char **desc);
@@ -482,6 +653,25 @@ int switchtec_event_wait_for(struct switchtec_dev *dev,
 			     enum switchtec_event_id e, int index,
 			     struct switchtec_event_summary *res,
 			     int timeout_ms);
+int switchtec_event_wait_set(struct switchtec_dev *dev,
+			     struct switchtec_event_wait_item *items,
+			     int nr_items,
+			     struct switchtec_event_summary *res,
+			     int latency_ms, int timeout_ms);
+struct switchtec_monitor *switchtec_monitor_new(struct switchtec_dev **devs,
+						int nr_devs, int poll_ms);
+void switchtec_monitor_free(struct switchtec_monitor *mon);
+int switchtec_monitor_run(struct switchtec_monitor *mon,
+			  switchtec_monitor_fn fn, void *arg, int timeout_ms);
+void switchtec_monitor_set_local(struct switchtec_monitor *mon,
+				 int local_only);
+void switchtec_monitor_set_journal(struct switchtec_monitor *mon,
+				   struct switchtec_journal *journal);
+struct switchtec_journal *switchtec_journal_new(size_t nr_entries);
+void switchtec_journal_free(struct switchtec_journal *journal);
+int switchtec_journal_next(struct switchtec_journal *journal,
+			   struct switchtec_journal_entry *entry);
+unsigned long switchtec_journal_dropped(struct switchtec_journal *journal);
 
 /******** ARBITRATION Management ********/
 
@@ -783,6 +973,7 @@ int switchtec_lat_get(struct switchtec_dev *dev, int clear,
 gasptr_t switchtec_gas_map(struct switchtec_dev *dev, int writeable,
                            size_t *map_size);
 void switchtec_gas_unmap(struct switchtec_dev *dev, gasptr_t map);
+int switchtec_gas_readahead(struct switchtec_dev *dev, int enable);
 
 #ifdef __cplusplus
 }
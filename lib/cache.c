@@ -0,0 +1,471 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Optional cache for device queries that rarely change
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+
+#include "switchtec/switchtec.h"
+#include "switchtec/mrpc.h"
+#include "switchtec/utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_MRPC_ENTRIES	32
+#define CACHE_KEY_LEN		16
+#define CACHE_FLASH_PARTS	8
+#define CACHE_FW_VER_LEN	32
+
+struct cache_mrpc_entry {
+	int valid;
+	uint64_t stamp;
+	uint32_t cmd;
+	size_t key_len;
+	uint8_t key[CACHE_KEY_LEN];
+	size_t resp_len;
+	uint8_t resp[MRPC_MAX_DATA_LEN];
+};
+
+struct switchtec_cache {
+	pthread_mutex_t lock;
+	uint64_t ttl_ns;
+
+	/*
+	 * Bumped on every invalidation so a response fetched before it
+	 * is not stored after it.
+	 */
+	unsigned gen;
+
+	unsigned next_victim;
+	struct cache_mrpc_entry mrpc[CACHE_MRPC_ENTRIES];
+
+	struct {
+		int valid;
+		uint64_t stamp;
+		struct switchtec_fw_image_info info;
+	} part[CACHE_FLASH_PARTS];
+
+	struct {
+		int valid;
+		uint64_t stamp;
+		char buf[CACHE_FW_VER_LEN];
+	} fw_ver;
+
+	/* The invalidating events as they were last seen in a summary */
+	struct switchtec_event_summary seen;
+};
+
+/**
+ * @defgroup Cache Query Cache
+ * @brief Avoid device traffic for repeated queries
+ *
+ * Once enabled with switchtec_cache_enable(), the answers to link status
+ * (and so switchtec_status()), flash reads, multi-config queries, flash
+ * partition info and the firmware version are remembered for the given
+ * time, which makes repeatedly polling switchtec_fw_part_info(),
+ * switchtec_fw_img_info(), switchtec_fw_cfg_info(), switchtec_status()
+ * and switchtec_get_fw_version() nearly free.
+ *
+ * Everything cached is dropped early when the library issues a command
+ * that changes it (any firmware download command other than a status
+ * query, resets and port binding) and when an event summary read through
+ * this handle shows a new system reset, partition reset or link state
+ * event. Changes made through other handles or left unnoticed are only
+ * picked up when the entries expire.
+ * @{
+ */
+
+static int cache_fresh(struct switchtec_cache *c, int valid, uint64_t stamp,
+		       uint64_t now)
+{
+	return valid && now - stamp < c->ttl_ns;
+}
+
+static void cache_flush(struct switchtec_cache *c)
+{
+	int i;
+
+	for (i = 0; i < CACHE_MRPC_ENTRIES; i++)
+		c->mrpc[i].valid = 0;
+	for (i = 0; i < CACHE_FLASH_PARTS; i++)
+		c->part[i].valid = 0;
+	c->fw_ver.valid = 0;
+	c->gen++;
+}
+
+/**
+ * @brief Enable caching of queries on a handle
+ * @param[in] dev	Switchtec device handle
+ * @param[in] ttl_ms	How long an answer may be reused for
+ * @return 0 on success, negative on failure
+ *
+ * Calling this again with the cache already enabled just changes the
+ * time to live. This must not be called while other threads are using
+ * the handle.
+ */
+int switchtec_cache_enable(struct switchtec_dev *dev, unsigned ttl_ms)
+{
+	struct switchtec_cache *c = dev->cache;
+
+	if (!ttl_ms) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	if (!c) {
+		c = calloc(1, sizeof(*c));
+		if (!c)
+			return -errno;
+
+		pthread_mutex_init(&c->lock, NULL);
+	}
+
+	c->ttl_ns = ttl_ms * 1000000ULL;
+	dev->cache = c;
+
+	return 0;
+}
+
+/**
+ * @brief Disable the query cache and free its memory
+ * @param[in] dev	Switchtec device handle
+ *
+ * This must not be called while other threads are using the handle.
+ */
+void switchtec_cache_disable(struct switchtec_dev *dev)
+{
+	struct switchtec_cache *c = dev->cache;
+
+	if (!c)
+		return;
+
+	dev->cache = NULL;
+	pthread_mutex_destroy(&c->lock);
+	free(c);
+}
+
+/**
+ * @brief Drop everything in the query cache
+ * @param[in] dev	Switchtec device handle
+ *
+ * Use this after changing the switch behind the library's back, for
+ * example through another handle.
+ */
+void switchtec_cache_invalidate(struct switchtec_dev *dev)
+{
+	struct switchtec_cache *c = dev->cache;
+
+	if (!c)
+		return;
+
+	pthread_mutex_lock(&c->lock);
+	cache_flush(c);
+	pthread_mutex_unlock(&c->lock);
+}
+
+/**@}*/
+
+static int cache_mrpc_cacheable(uint32_t cmd)
+{
+	switch (cmd & SWITCHTEC_CMD_MASK) {
+	case MRPC_LNKSTAT:
+	case MRPC_RD_FLASH:
+	case MRPC_MULTI_CFG:
+		return 1;
+	}
+
+	return 0;
+}
+
+static int cache_mrpc_invalidates(uint32_t cmd, int subcmd)
+{
+	switch (cmd & SWITCHTEC_CMD_MASK) {
+	case MRPC_FWDNLD:
+		return subcmd != MRPC_FWDNLD_GET_STATUS;
+	case MRPC_RESET:
+	case MRPC_PORTPARTP2P:
+		return 1;
+	}
+
+	return 0;
+}
+
+static int cache_key(const struct switchtec_iovec *payload, int payload_cnt,
+		     uint8_t *key, size_t *key_len)
+{
+	size_t len = iov_total_len(payload, payload_cnt);
+	int i;
+
+	if (len > CACHE_KEY_LEN)
+		return 0;
+
+	for (i = 0, *key_len = 0; i < payload_cnt; i++) {
+		memcpy(&key[*key_len], payload[i].iov_base,
+		       payload[i].iov_len);
+		*key_len += payload[i].iov_len;
+	}
+
+	return 1;
+}
+
+static struct cache_mrpc_entry *
+cache_mrpc_find(struct switchtec_cache *c, uint32_t cmd, const uint8_t *key,
+		size_t key_len, size_t resp_len)
+{
+	struct cache_mrpc_entry *ent;
+	int i;
+
+	for (i = 0; i < CACHE_MRPC_ENTRIES; i++) {
+		ent = &c->mrpc[i];
+		if (ent->valid && ent->cmd == cmd &&
+		    ent->key_len == key_len && ent->resp_len == resp_len &&
+		    !memcmp(ent->key, key, key_len))
+			return ent;
+	}
+
+	return NULL;
+}
+
+/*
+ * Try to answer an MRPC command from the cache. Returns 1 and fills in
+ * the response on a hit, otherwise returns 0 and the generation to pass
+ * to switchtec_cache_mrpc_store().
+ */
+int switchtec_cache_mrpc_lookup(struct switchtec_dev *dev, uint32_t cmd,
+				const struct switchtec_iovec *payload,
+				int payload_cnt,
+				const struct switchtec_iovec *resp,
+				int resp_cnt, unsigned *gen)
+{
+	struct switchtec_cache *c = dev->cache;
+	struct cache_mrpc_entry *ent;
+	uint8_t key[CACHE_KEY_LEN];
+	size_t key_len, off;
+	int i, hit = 0;
+
+	if (!cache_mrpc_cacheable(cmd) ||
+	    !cache_key(payload, payload_cnt, key, &key_len))
+		return 0;
+
+	pthread_mutex_lock(&c->lock);
+
+	*gen = c->gen;
+
+	ent = cache_mrpc_find(c, cmd, key, key_len,
+			      iov_total_len(resp, resp_cnt));
+	if (ent && cache_fresh(c, ent->valid, ent->stamp,
+			       switchtec_stats_now())) {
+		for (i = 0, off = 0; i < resp_cnt; i++) {
+			memcpy(resp[i].iov_base, &ent->resp[off],
+			       resp[i].iov_len);
+			off += resp[i].iov_len;
+		}
+		hit = 1;
+	}
+
+	pthread_mutex_unlock(&c->lock);
+
+	return hit;
+}
+
+/*
+ * Called after an MRPC command has run: remember a successful answer to
+ * a cacheable query or drop everything if the command changes state.
+ */
+void switchtec_cache_mrpc_store(struct switchtec_dev *dev, uint32_t cmd,
+				const struct switchtec_iovec *payload,
+				int payload_cnt,
+				const struct switchtec_iovec *resp,
+				int resp_cnt, int ret, unsigned gen)
+{
+	struct switchtec_cache *c = dev->cache;
+	struct cache_mrpc_entry *ent;
+	uint8_t key[CACHE_KEY_LEN];
+	size_t key_len, resp_len, off;
+	int i;
+
+	if (cache_mrpc_invalidates(cmd, switchtec_stats_subcmd(cmd, payload,
+							       payload_cnt))) {
+		switchtec_cache_invalidate(dev);
+		return;
+	}
+
+	resp_len = iov_total_len(resp, resp_cnt);
+
+	if (ret || !cache_mrpc_cacheable(cmd) ||
+	    resp_len > MRPC_MAX_DATA_LEN ||
+	    !cache_key(payload, payload_cnt, key, &key_len))
+		return;
+
+	pthread_mutex_lock(&c->lock);
+
+	if (gen != c->gen)
+		goto out;
+
+	ent = cache_mrpc_find(c, cmd, key, key_len, resp_len);
+	if (!ent) {
+		ent = &c->mrpc[c->next_victim];
+		c->next_victim = (c->next_victim + 1) % CACHE_MRPC_ENTRIES;
+	}
+
+	ent->valid = 1;
+	ent->stamp = switchtec_stats_now();
+	ent->cmd = cmd;
+	ent->key_len = key_len;
+	memcpy(ent->key, key, key_len);
+	ent->resp_len = resp_len;
+	for (i = 0, off = 0; i < resp_cnt; i++) {
+		memcpy(&ent->resp[off], resp[i].iov_base, resp[i].iov_len);
+		off += resp[i].iov_len;
+	}
+
+out:
+	pthread_mutex_unlock(&c->lock);
+}
+
+/*
+ * Invalidation only, for async commands whose payload is gone by the
+ * time they complete.
+ */
+void switchtec_cache_mrpc_done(struct switchtec_dev *dev, uint32_t cmd,
+			       int subcmd)
+{
+	if (cache_mrpc_invalidates(cmd, subcmd))
+		switchtec_cache_invalidate(dev);
+}
+
+int switchtec_cache_flash_part(struct switchtec_dev *dev,
+			       struct switchtec_fw_image_info *info,
+			       enum switchtec_fw_image_type part)
+{
+	struct switchtec_cache *c = dev->cache;
+	uint64_t now = switchtec_stats_now();
+	unsigned gen;
+	int ret;
+
+	if (part >= CACHE_FLASH_PARTS)
+		return dev->ops->flash_part(dev, info, part);
+
+	pthread_mutex_lock(&c->lock);
+	if (cache_fresh(c, c->part[part].valid, c->part[part].stamp, now)) {
+		*info = c->part[part].info;
+		pthread_mutex_unlock(&c->lock);
+		return 0;
+	}
+	gen = c->gen;
+	pthread_mutex_unlock(&c->lock);
+
+	ret = dev->ops->flash_part(dev, info, part);
+	if (ret)
+		return ret;
+
+	pthread_mutex_lock(&c->lock);
+	if (gen == c->gen) {
+		c->part[part].valid = 1;
+		c->part[part].stamp = now;
+		c->part[part].info = *info;
+	}
+	pthread_mutex_unlock(&c->lock);
+
+	return 0;
+}
+
+int switchtec_cache_get_fw_version(struct switchtec_dev *dev, char *buf,
+				   size_t buflen)
+{
+	struct switchtec_cache *c = dev->cache;
+	uint64_t now = switchtec_stats_now();
+	char ver[CACHE_FW_VER_LEN];
+	unsigned gen;
+	int ret;
+
+	pthread_mutex_lock(&c->lock);
+	if (cache_fresh(c, c->fw_ver.valid, c->fw_ver.stamp, now)) {
+		snprintf(buf, buflen, "%s", c->fw_ver.buf);
+		pthread_mutex_unlock(&c->lock);
+		return 0;
+	}
+	gen = c->gen;
+	pthread_mutex_unlock(&c->lock);
+
+	ret = dev->ops->get_fw_version(dev, ver, sizeof(ver));
+	if (ret)
+		return ret;
+
+	snprintf(buf, buflen, "%s", ver);
+
+	pthread_mutex_lock(&c->lock);
+	if (gen == c->gen) {
+		c->fw_ver.valid = 1;
+		c->fw_ver.stamp = now;
+		memcpy(c->fw_ver.buf, ver, sizeof(ver));
+	}
+	pthread_mutex_unlock(&c->lock);
+
+	return 0;
+}
+
+/*
+ * Look for newly occurred reset and link state events in a summary the
+ * caller just read from the device.
+ */
+void switchtec_cache_events(struct switchtec_dev *dev,
+			    struct switchtec_event_summary *sum)
+{
+	static const enum switchtec_event_id watched[] = {
+		SWITCHTEC_GLOBAL_EVT_SYS_RESET,
+		SWITCHTEC_PART_EVT_PART_RESET,
+		SWITCHTEC_PFF_EVT_LINK_STATE,
+	};
+	struct switchtec_cache *c = dev->cache;
+	struct switchtec_event_summary mask = {0}, cur = {0};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(watched); i++)
+		switchtec_event_summary_set(&mask, watched[i],
+					    SWITCHTEC_EVT_IDX_ALL);
+
+	cur.global = sum->global & mask.global;
+	for (i = 0; i < ARRAY_SIZE(cur.part); i++)
+		cur.part[i] = sum->part[i] & mask.part[i];
+	for (i = 0; i < ARRAY_SIZE(cur.pff); i++)
+		cur.pff[i] = sum->pff[i] & mask.pff[i];
+
+	pthread_mutex_lock(&c->lock);
+
+	/* Only a change matters: a bit nobody clears stays set */
+	if (memcmp(&cur, &c->seen, sizeof(cur))) {
+		c->seen = cur;
+		cache_flush(c);
+	}
+
+	pthread_mutex_unlock(&c->lock);
+}
@@ -0,0 +1,380 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec MRPC command queue for sharing a handle between threads
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+
+#include "switchtec/mrpc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Maximum number of commands a dispatcher will issue on behalf of other
+ * threads after its own command has completed before it hands the
+ * queue over to the next waiter.
+ */
+#define CMDQ_MAX_BATCH 64
+
+struct switchtec_cmd_req {
+	uint32_t cmd;
+	const struct switchtec_iovec *payload;
+	int payload_cnt;
+	const struct switchtec_iovec *resp;
+	int resp_cnt;
+
+	int ret;
+	int err;
+	int done;
+
+	pthread_cond_t cond;
+	struct switchtec_cmd_req *next;
+};
+
+void switchtec_cmdq_init(struct switchtec_dev *dev)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->idle, NULL);
+	q->head = NULL;
+	q->tail = &q->head;
+	q->idle_waiters = 0;
+	q->busy = 0;
+	q->async = 0;
+	q->flat_buf = NULL;
+
+	memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
+void switchtec_cmdq_destroy(struct switchtec_dev *dev)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+
+	free(q->flat_buf);
+	pthread_cond_destroy(&q->idle);
+	pthread_mutex_destroy(&q->lock);
+}
+
+static int cmdq_owned_locked(struct switchtec_cmdq *q)
+{
+	return q->async && pthread_equal(q->owner, pthread_self());
+}
+
+/*
+ * Called with the lock held after the MRPC has been released. The
+ * thread at the head of the queue becomes the next dispatcher.
+ */
+static void cmdq_kick(struct switchtec_cmdq *q)
+{
+	if (q->head)
+		pthread_cond_signal(&q->head->cond);
+
+	if (q->idle_waiters)
+		pthread_cond_broadcast(&q->idle);
+}
+
+/*
+ * For backends without a native cmdv op: gather the payload and scatter
+ * the response through the queue's bounce buffers, unless each side is
+ * a single segment already. Only the dispatcher gets here, so the
+ * buffers are never shared.
+ */
+static int cmdv_flatten(struct switchtec_dev *dev, uint32_t cmd,
+			const struct switchtec_iovec *payload, int payload_cnt,
+			const struct switchtec_iovec *resp, int resp_cnt)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+	uint8_t *pbuf = NULL, *rbuf = NULL;
+	const void *pdata;
+	void *rdata;
+	size_t plen, rlen, off;
+	int i, ret;
+
+	plen = iov_total_len(payload, payload_cnt);
+	rlen = iov_total_len(resp, resp_cnt);
+
+	if (plen > MRPC_MAX_DATA_LEN || rlen > MRPC_MAX_DATA_LEN) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	if (payload_cnt > 1 || resp_cnt > 1) {
+		if (!q->flat_buf) {
+			q->flat_buf = malloc(2 * MRPC_MAX_DATA_LEN);
+			if (!q->flat_buf)
+				return -errno;
+		}
+
+		pbuf = q->flat_buf;
+		rbuf = q->flat_buf + MRPC_MAX_DATA_LEN;
+	}
+
+	pdata = pbuf;
+	rdata = rbuf;
+
+	if (payload_cnt == 1) {
+		pdata = payload->iov_base;
+	} else {
+		for (i = 0, off = 0; i < payload_cnt; i++) {
+			memcpy(&pbuf[off], payload[i].iov_base,
+			       payload[i].iov_len);
+			off += payload[i].iov_len;
+		}
+	}
+
+	if (resp_cnt == 0)
+		rdata = NULL;
+	else if (resp_cnt == 1)
+		rdata = resp->iov_base;
+
+	ret = dev->ops->cmd(dev, cmd, pdata, plen, rdata, rlen);
+
+	if (resp_cnt > 1) {
+		for (i = 0, off = 0; i < resp_cnt; i++) {
+			memcpy(resp[i].iov_base, &rbuf[off], resp[i].iov_len);
+			off += resp[i].iov_len;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Called with the lock held and the MRPC owned. The lock is dropped
+ * while each command runs so other threads can keep queueing behind us.
+ */
+static void cmdq_dispatch(struct switchtec_dev *dev,
+			  struct switchtec_cmd_req *self)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+	struct switchtec_cmd_req *req;
+	uint64_t start;
+	int subcmd;
+	int batch = 0;
+
+	while ((req = q->head)) {
+		if (self->done && batch++ >= CMDQ_MAX_BATCH)
+			break;
+
+		q->head = req->next;
+		if (!q->head)
+			q->tail = &q->head;
+
+		pthread_mutex_unlock(&q->lock);
+
+		start = switchtec_stats_now();
+
+		errno = 0;
+		if (dev->ops->cmdv)
+			req->ret = dev->ops->cmdv(dev, req->cmd, req->payload,
+						  req->payload_cnt, req->resp,
+						  req->resp_cnt);
+		else
+			req->ret = cmdv_flatten(dev, req->cmd, req->payload,
+						req->payload_cnt, req->resp,
+						req->resp_cnt);
+		req->err = errno;
+
+		subcmd = switchtec_stats_subcmd(req->cmd, req->payload,
+						req->payload_cnt);
+		switchtec_stats_record(dev, req->cmd, subcmd,
+				       iov_total_len(req->payload,
+						     req->payload_cnt),
+				       iov_total_len(req->resp, req->resp_cnt),
+				       req->ret, switchtec_stats_now() - start);
+
+		pthread_mutex_lock(&q->lock);
+
+		req->done = 1;
+		if (req != self)
+			pthread_cond_signal(&req->cond);
+	}
+}
+
+/**
+ * @brief Queue an MRPC command and wait for its result
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  cmd		Command ID (with the PAX ID already applied)
+ * @param[in]  payload		Input data segments
+ * @param[in]  payload_cnt	Number of input segments
+ * @param[in]  resp		Output data segments
+ * @param[in]  resp_cnt		Number of output segments
+ * @return The command's own return value; errno is set to the value
+ *	the backend left for this command, regardless of what other
+ *	threads' commands did in the meantime.
+ */
+int switchtec_cmdq_exec(struct switchtec_dev *dev, uint32_t cmd,
+			const struct switchtec_iovec *payload,
+			int payload_cnt,
+			const struct switchtec_iovec *resp, int resp_cnt)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+	struct switchtec_cmd_req req = {
+		.cmd = cmd,
+		.payload = payload,
+		.payload_cnt = payload_cnt,
+		.resp = resp,
+		.resp_cnt = resp_cnt,
+	};
+
+	pthread_mutex_lock(&q->lock);
+
+	/* Waiting for our own async command to complete would deadlock */
+	if (cmdq_owned_locked(q)) {
+		pthread_mutex_unlock(&q->lock);
+		errno = EBUSY;
+		return -errno;
+	}
+
+	pthread_cond_init(&req.cond, NULL);
+
+	*q->tail = &req;
+	q->tail = &req.next;
+
+	while (!req.done) {
+		if (q->busy) {
+			pthread_cond_wait(&req.cond, &q->lock);
+			continue;
+		}
+
+		q->busy = 1;
+		cmdq_dispatch(dev, &req);
+		q->busy = 0;
+		cmdq_kick(q);
+	}
+
+	pthread_mutex_unlock(&q->lock);
+	pthread_cond_destroy(&req.cond);
+
+	errno = req.err;
+	return req.ret;
+}
+
+/**
+ * @brief Take exclusive ownership of the MRPC for an async command
+ * @param[in]  dev	Switchtec device handle
+ * @return 0 on success, or -EBUSY if this thread already owns it
+ */
+int switchtec_cmdq_acquire(struct switchtec_dev *dev)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+
+	pthread_mutex_lock(&q->lock);
+
+	if (cmdq_owned_locked(q)) {
+		pthread_mutex_unlock(&q->lock);
+		errno = EBUSY;
+		return -errno;
+	}
+
+	q->idle_waiters++;
+	while (q->busy)
+		pthread_cond_wait(&q->idle, &q->lock);
+	q->idle_waiters--;
+
+	q->busy = 1;
+	q->async = 1;
+	q->owner = pthread_self();
+
+	pthread_mutex_unlock(&q->lock);
+
+	return 0;
+}
+
+/**
+ * @brief Check whether the calling thread owns the MRPC
+ * @param[in]  dev	Switchtec device handle
+ * @return 1 if an async command submitted by this thread is outstanding
+ */
+int switchtec_cmdq_owned(struct switchtec_dev *dev)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+	int ret;
+
+	pthread_mutex_lock(&q->lock);
+	ret = cmdq_owned_locked(q);
+	pthread_mutex_unlock(&q->lock);
+
+	return ret;
+}
+
+/**
+ * @brief Release MRPC ownership taken by switchtec_cmdq_acquire()
+ * @param[in]  dev	Switchtec device handle
+ *
+ * errno is preserved so this may be called on an error path.
+ */
+void switchtec_cmdq_release(struct switchtec_dev *dev)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+	int err = errno;
+
+	pthread_mutex_lock(&q->lock);
+	q->busy = 0;
+	q->async = 0;
+	cmdq_kick(q);
+	pthread_mutex_unlock(&q->lock);
+
+	errno = err;
+}
+
+/**
+ * @brief Wait for the MRPC to go idle and hold off any new commands
+ * @param[in]  dev	Switchtec device handle
+ *
+ * Used to take a consistent look at state the dispatcher updates without
+ * locking. Returns immediately if the calling thread owns an async
+ * command. Must be followed by switchtec_cmdq_resume().
+ */
+void switchtec_cmdq_pause(struct switchtec_dev *dev)
+{
+	struct switchtec_cmdq *q = &dev->cmdq;
+
+	pthread_mutex_lock(&q->lock);
+
+	if (cmdq_owned_locked(q))
+		return;
+
+	q->idle_waiters++;
+	while (q->busy)
+		pthread_cond_wait(&q->idle, &q->lock);
+	q->idle_waiters--;
+}
+
+/**
+ * @brief Let commands run again after switchtec_cmdq_pause()
+ * @param[in]  dev	Switchtec device handle
+ */
+void switchtec_cmdq_resume(struct switchtec_dev *dev)
+{
+	pthread_mutex_unlock(&dev->cmdq.lock);
+}
@@ -25,6 +25,9 @@
 #ifdef __linux__
 
 #include "crc8.h"
+
+#include <pthread.h>
+
 static uint8_t crc8_0107_lut[] =
 {
 	0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15,
@@ -62,15 +65,56 @@ static uint8_t crc8_0107_lut[] =
 };
 
 
+/*
+ * Slicing-by-8 tables: crc8_slice[k][x] is the remainder of byte x
+ * followed by k zero bytes, so eight message bytes can be folded into
+ * the remainder with eight independent lookups instead of a serial
+ * chain of dependent ones. crc8_slice[0] is crc8_0107_lut.
+ */
+#define CRC8_SLICES		8
+
+static uint8_t crc8_slice[CRC8_SLICES][256];
+static pthread_once_t crc8_slice_once = PTHREAD_ONCE_INIT;
+
+static void crc8_slice_init(void)
+{
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		crc8_slice[0][i] = crc8_0107_lut[i];
+		for (k = 1; k < CRC8_SLICES; k++)
+			crc8_slice[k][i] =
+				crc8_0107_lut[crc8_slice[k - 1][i]];
+	}
+}
+
 uint8_t crc8(uint8_t *msg_ptr, uint32_t byte_cnt, uint32_t oldchksum,
 	      bool init)
 {
-	uint32_t  offset;
+	uint32_t  offset = 0;
 	uint8_t   remainder;
 
 	remainder = ((init == true) ? 0 : oldchksum);
 
-	for (offset = 0; offset < byte_cnt; offset++) {
+	if (byte_cnt >= CRC8_SLICES) {
+		pthread_once(&crc8_slice_once, crc8_slice_init);
+
+		for (; byte_cnt - offset >= CRC8_SLICES;
+		     offset += CRC8_SLICES) {
+			const uint8_t *p = &msg_ptr[offset];
+
+			remainder = crc8_slice[7][remainder ^ p[0]] ^
+				    crc8_slice[6][p[1]] ^
+				    crc8_slice[5][p[2]] ^
+				    crc8_slice[4][p[3]] ^
+				    crc8_slice[3][p[4]] ^
+				    crc8_slice[2][p[5]] ^
+				    crc8_slice[1][p[6]] ^
+				    crc8_slice[0][p[7]];
+		}
+	}
+
+	for (; offset < byte_cnt; offset++) {
 		remainder = crc8_0107_lut[remainder ^ msg_ptr[offset]];
 	}
 
@@ -40,6 +40,10 @@
 #include <string.h>
 #include <strings.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /**
  * @defgroup Event Event Management
  * @brief List and wait for switch events
@@ -49,7 +53,7 @@
  * occured since they were last cleared. switchtec_event_ctl() can be used
  * to clear and event or manage what happens when an event occurs.
  * switchtec_event_wait_for() may be used to block until a specific event
- * occurs.
+ * occurs and switchtec_event_wait_set() until any of a set of events occurs.
  *
  * @{
  */
@@ -232,6 +236,41 @@ int switchtec_event_summary_test(struct switchtec_event_summary *sum,
 	return 0;
 }
 
+/*
+ * Index of the first non-zero word in w[start, n), or n if they are
+ * all zero. Most of a summary is usually empty, so check several words
+ * at a time.
+ */
+static int next_nonzero_word(const unsigned *w, int start, int n)
+{
+	int i = start;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&w[i]);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, zero)) != 0xFFFF)
+			break;
+	}
+#else
+	uint64_t v;
+
+	for (; i + 2 <= n; i += 2) {
+		memcpy(&v, &w[i], sizeof(v));
+		if (v)
+			break;
+	}
+#endif
+
+	for (; i < n; i++)
+		if (w[i])
+			return i;
+
+	return n;
+}
+
 /**
  * @brief Iterate through all set bits in an event summary structure
  * @param[in]  sum	Summary structure to set the bit in
@@ -242,6 +281,9 @@ int switchtec_event_summary_test(struct switchtec_event_summary *sum,
  * This function is meant to be called in a loop. It finds the lowest
  * bit set and returns the corresponding event id and index. It then
  * clears that bit in the structure.
+ *
+ * Each call scans from the start of the structure;
+ * switchtec_event_iter_next() does not and leaves the summary intact.
  */
 int switchtec_event_summary_iter(struct switchtec_event_summary *sum,
 				 enum switchtec_event_id *e,
@@ -254,61 +296,167 @@ int switchtec_event_summary_iter(struct switchtec_event_summary *sum,
 
 	*idx = 0;
 
-	bit = ffs(sum->global) - 1;
-	if (bit >= 0) {
+	if (sum->global) {
+		bit = __builtin_ctzll(sum->global);
 		*e = global_event_bits[bit];
-		sum->global &= ~(1 << bit);
+		sum->global &= ~(1ULL << bit);
 		return 1;
 	}
 
-	for (*idx = 0; *idx < ARRAY_SIZE(sum->part); (*idx)++) {
-		bit = ffs(sum->part[*idx]) - 1;
-		if (bit < 0)
-			continue;
-
+	*idx = next_nonzero_word(sum->part, 0, ARRAY_SIZE(sum->part));
+	if (*idx < ARRAY_SIZE(sum->part)) {
+		bit = __builtin_ctz(sum->part[*idx]);
 		*e = part_event_bits[bit];
-		sum->part[*idx] &= ~(1 << bit);
+		sum->part[*idx] &= ~(1U << bit);
 		return 1;
 	}
 
-	for (*idx = 0; *idx < ARRAY_SIZE(sum->pff); (*idx)++) {
-		bit = ffs(sum->pff[*idx]) - 1;
-		if (bit < 0)
-			continue;
-
+	*idx = next_nonzero_word(sum->pff, 0, ARRAY_SIZE(sum->pff));
+	if (*idx < ARRAY_SIZE(sum->pff)) {
+		bit = __builtin_ctz(sum->pff[*idx]);
 		*e = pff_event_bits[bit];
-		sum->pff[*idx] &= ~(1 << bit);
+		sum->pff[*idx] &= ~(1U << bit);
 		return 1;
 	}
 
 	return 0;
 }
 
+#define ITER_WORD_GLOBAL	0
+#define ITER_WORD_PART		1
+#define ITER_WORD_PFF		(ITER_WORD_PART + SWITCHTEC_MAX_PARTS)
+#define ITER_WORD_END		(ITER_WORD_PFF + SWITCHTEC_MAX_PFF_CSR)
+
 /**
- * @brief Check if one or more events have occurred
- * @param[in]  dev	Switchtec device handle
- * @param[in]  chk	Summary structure with events to check
- * @param[out] res	Returned current events summary, (may be NULL)
- * @return 1 if one of the events in chk occurred, 0 otherwise or a
- * 	negative value if an error occurred.
+ * @brief Start iterating through the events set in a summary
+ * @param[out] it	Iterator to initialize
+ * @param[in]  sum	Summary to iterate over; it is not modified and
+ *	must remain valid while the iterator is in use
  */
-int switchtec_event_check(struct switchtec_dev *dev,
-			  struct switchtec_event_summary *chk,
-			  struct switchtec_event_summary *res)
+void switchtec_event_iter_init(struct switchtec_event_iter *it,
+			       const struct switchtec_event_summary *sum)
 {
-	struct switchtec_event_summary res_tmp;
+	it->sum = sum;
+	it->word = ITER_WORD_GLOBAL;
+	it->next_word = ITER_WORD_GLOBAL;
+	it->bits = 0;
+}
+
+/*
+ * Load the next non-zero summary word into the iterator. Returns 0
+ * once the whole summary has been consumed.
+ */
+static int event_iter_load(struct switchtec_event_iter *it)
+{
+	const struct switchtec_event_summary *sum = it->sum;
+	int w = it->next_word;
 	int i;
-	int ret;
 
-	if (!chk)
-		return -EINVAL;
+	if (w == ITER_WORD_GLOBAL) {
+		it->word = w++;
+		it->bits = sum->global;
+		if (it->bits) {
+			it->next_word = w;
+			return 1;
+		}
+	}
 
-	if (!res)
-		res = &res_tmp;
+	if (w < ITER_WORD_PFF) {
+		i = next_nonzero_word(sum->part, w - ITER_WORD_PART,
+				      SWITCHTEC_MAX_PARTS);
+		if (i < SWITCHTEC_MAX_PARTS) {
+			it->word = ITER_WORD_PART + i;
+			it->bits = sum->part[i];
+			it->next_word = it->word + 1;
+			return 1;
+		}
+		w = ITER_WORD_PFF;
+	}
 
-	ret = switchtec_event_summary(dev, res);
-	if (ret)
-		return ret;
+	if (w < ITER_WORD_END) {
+		i = next_nonzero_word(sum->pff, w - ITER_WORD_PFF,
+				      SWITCHTEC_MAX_PFF_CSR);
+		if (i < SWITCHTEC_MAX_PFF_CSR) {
+			it->word = ITER_WORD_PFF + i;
+			it->bits = sum->pff[i];
+			it->next_word = it->word + 1;
+			return 1;
+		}
+	}
+
+	it->next_word = ITER_WORD_END;
+	return 0;
+}
+
+/**
+ * @brief Get the next event set in the summary being iterated
+ * @param[in,out] it	Iterator set up with switchtec_event_iter_init()
+ * @param[out]    e	Event ID which was set
+ * @param[out]    idx	Event index (partition or port function, depending
+ *	on the event type)
+ * @return 1 if an event was returned, 0 when there are no more
+ *
+ * Unlike switchtec_event_summary_iter(), this keeps its place between
+ * calls and skips bits that don't correspond to a known event, so
+ * walking k events costs O(k) plus a fast scan over empty words.
+ */
+int switchtec_event_iter_next(struct switchtec_event_iter *it,
+			      enum switchtec_event_id *e, int *idx)
+{
+	int bit;
+
+	while (1) {
+		while (!it->bits)
+			if (!event_iter_load(it))
+				return 0;
+
+		bit = __builtin_ctzll(it->bits);
+		it->bits &= it->bits - 1;
+
+		if (it->word == ITER_WORD_GLOBAL) {
+			*e = global_event_bits[bit];
+			*idx = 0;
+		} else if (it->word < ITER_WORD_PFF) {
+			*e = part_event_bits[bit];
+			*idx = it->word - ITER_WORD_PART;
+		} else {
+			*e = pff_event_bits[bit];
+			*idx = it->word - ITER_WORD_PFF;
+		}
+
+		if (*e != SWITCHTEC_EVT_INVALID)
+			return 1;
+	}
+}
+
+/**
+ * @brief Decode every event set in a summary in one pass
+ * @param[in]  sum		Summary to decode
+ * @param[out] pairs		Array to fill with the (event, index) pairs
+ * @param[in]  max_pairs	Number of entries \p pairs can hold
+ * @return The number of pairs written. If this equals \p max_pairs,
+ *	there may be more events that did not fit.
+ */
+int switchtec_event_summary_decode(const struct switchtec_event_summary *sum,
+				   struct switchtec_event_pair *pairs,
+				   int max_pairs)
+{
+	struct switchtec_event_iter it;
+	int n = 0;
+
+	switchtec_event_iter_init(&it, sum);
+
+	while (n < max_pairs &&
+	       switchtec_event_iter_next(&it, &pairs[n].e, &pairs[n].index))
+		n++;
+
+	return n;
+}
+
+static int event_summary_match(const struct switchtec_event_summary *chk,
+			       const struct switchtec_event_summary *res)
+{
+	int i;
 
 	if (chk->global & res->global)
 		return 1;
@@ -330,6 +478,34 @@ int switchtec_event_check(struct switchtec_dev *dev,
 	return 0;
 }
 
+/**
+ * @brief Check if one or more events have occurred
+ * @param[in]  dev	Switchtec device handle
+ * @param[in]  chk	Summary structure with events to check
+ * @param[out] res	Returned current events summary, (may be NULL)
+ * @return 1 if one of the events in chk occurred, 0 otherwise or a
+ * 	negative value if an error occurred.
+ */
+int switchtec_event_check(struct switchtec_dev *dev,
+			  struct switchtec_event_summary *chk,
+			  struct switchtec_event_summary *res)
+{
+	struct switchtec_event_summary res_tmp;
+	int ret;
+
+	if (!chk)
+		return -EINVAL;
+
+	if (!res)
+		res = &res_tmp;
+
+	ret = switchtec_event_summary(dev, res);
+	if (ret)
+		return ret;
+
+	return event_summary_match(chk, res);
+}
+
 /**
  * @brief Get the name and description strings as well as the type (global,
  *     partition or pff) for a specific event ID.
@@ -354,74 +530,142 @@ enum switchtec_event_type switchtec_event_info(enum switchtec_event_id e,
 	return events[e].type;
 }
 
-/**
- * @brief Block until a specific event occurs
- * @param[in]  dev		Switchtec device handle
- * @param[in]  e		Event ID to wait for
- * @param[in]  index		Event index (partition or port)
- * @param[out] res		Current event summary set, after waiting
- * @param[in]  timeout_ms	Timeout of this many milliseconds
- * @return 1 if the event occurred, 0 on a timeout and a negative number
- *	an error.
+/*
+ * Wait for an event in the set using the backend's event interrupt:
+ * sleep in switchtec_event_wait() and only read the summary when it
+ * reports that something happened.
  */
-int switchtec_event_wait_for(struct switchtec_dev *dev,
-			     enum switchtec_event_id e, int index,
-			     struct switchtec_event_summary *res,
-			     int timeout_ms)
+static int event_wait_irq(struct switchtec_dev *dev,
+			  struct switchtec_event_summary *set,
+			  struct switchtec_event_summary *res,
+			  int timeout_ms)
 {
-	struct timeval tv;
-	long long start, now;
-	struct switchtec_event_summary wait_for = {0};
+	uint64_t start = switchtec_stats_now();
+	int wait_ms = -1;
 	int ret;
 
-	if (dev->ops->event_wait_for)
-		return dev->ops->event_wait_for(dev, e, index, res, timeout_ms);
+	while (1) {
+		ret = switchtec_event_check(dev, set, res);
+		if (ret)
+			return ret;
 
-	ret = switchtec_event_summary_set(&wait_for, e, index);
-	if (ret)
-		return ret;
+		if (timeout_ms > 0) {
+			wait_ms = timeout_ms - (int)((switchtec_stats_now() -
+						      start) / 1000000);
+			if (wait_ms <= 0)
+				return 0;
+		}
 
-	ret = switchtec_event_ctl(dev, e, index,
-				  SWITCHTEC_EVT_FLAG_CLEAR |
-				  SWITCHTEC_EVT_FLAG_EN_POLL,
-				  NULL);
-	if (ret < 0)
-		return ret;
+		ret = switchtec_event_wait(dev, wait_ms);
+		if (ret < 0)
+			return ret;
+	}
+}
 
-	ret = gettimeofday(&tv, NULL);
-	if (ret)
-		return ret;
+/**
+ * @brief Block until any event in a set occurs
+ * @param[in]     dev		Switchtec device handle
+ * @param[in,out] items		Events to wait for; the fired member of
+ *	each is set if that event occurred
+ * @param[in]     nr_items	Number of entries in \p items
+ * @param[out]    res		Current event summary set, after waiting
+ *	(may be NULL)
+ * @param[in]     latency_ms	How late, in milliseconds, an event may be
+ *	noticed on backends without event interrupts (0 for the default)
+ * @param[in]     timeout_ms	Timeout of this many milliseconds
+ * @return The number of entries that fired, 0 on a timeout and a
+ *	negative number on an error.
+ *
+ * Every event in the set is cleared and armed before waiting. Backends
+ * with event interrupts (eg. the Linux kernel driver) sleep until the
+ * interrupt fires. Others poll the event summary as slowly as
+ * \p latency_ms allows.
+ */
+int switchtec_event_wait_set(struct switchtec_dev *dev,
+			     struct switchtec_event_wait_item *items,
+			     int nr_items,
+			     struct switchtec_event_summary *res,
+			     int latency_ms, int timeout_ms)
+{
+	struct switchtec_event_summary set = {0}, one, res_tmp;
+	int fired = 0;
+	int ret;
+	int i;
 
-	now = start = ((tv.tv_sec) * 1000 + tv.tv_usec / 1000);
+	if (!items || nr_items <= 0) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
 
-	while (1) {
-		ret = switchtec_event_wait(dev, timeout_ms > 0 ?
-					   now - start + timeout_ms : -1);
-		if (ret < 0)
-			return ret;
+	if (!res)
+		res = &res_tmp;
 
-		if (ret == 0)
-			goto next;
+	for (i = 0; i < nr_items; i++) {
+		items[i].fired = 0;
 
-		ret = switchtec_event_check(dev, &wait_for, res);
+		ret = switchtec_event_summary_set(&set, items[i].e,
+						  items[i].index);
+		if (ret)
+			return ret;
+
+		ret = switchtec_event_ctl(dev, items[i].e, items[i].index,
+					  SWITCHTEC_EVT_FLAG_CLEAR |
+					  SWITCHTEC_EVT_FLAG_EN_POLL,
+					  NULL);
 		if (ret < 0)
 			return ret;
+	}
 
-		if (ret)
-			return 1;
+	if (dev->ops->event_wait_set) {
+		ret = dev->ops->event_wait_set(dev, &set, res, latency_ms,
+					       timeout_ms);
+	} else if (dev->ops->event_wait) {
+		ret = event_wait_irq(dev, &set, res, timeout_ms);
+	} else {
+		errno = ENOTSUP;
+		return -errno;
+	}
 
-next:
-		ret = gettimeofday(&tv, NULL);
-		if (ret)
-			return ret;
+	if (ret < 0)
+		return ret;
 
-		now = ((tv.tv_sec) * 1000 + tv.tv_usec / 1000);
+	if (dev->cache)
+		switchtec_cache_events(dev, res);
 
-		if (timeout_ms > 0 && now - start >= timeout_ms) {
-			ret = switchtec_event_summary(dev, res);
-			return ret;
-		}
+	if (!ret)
+		return 0;
+
+	for (i = 0; i < nr_items; i++) {
+		memset(&one, 0, sizeof(one));
+		switchtec_event_summary_set(&one, items[i].e, items[i].index);
+		items[i].fired = event_summary_match(&one, res);
+		fired += items[i].fired;
 	}
+
+	return fired;
+}
+
+/**
+ * @brief Block until a specific event occurs
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  e		Event ID to wait for
+ * @param[in]  index		Event index (partition or port)
+ * @param[out] res		Current event summary set, after waiting
+ * @param[in]  timeout_ms	Timeout of this many milliseconds
+ * @return 1 if the event occurred, 0 on a timeout and a negative number
+ *	an error.
+ */
+int switchtec_event_wait_for(struct switchtec_dev *dev,
+			     enum switchtec_event_id e, int index,
+			     struct switchtec_event_summary *res,
+			     int timeout_ms)
+{
+	struct switchtec_event_wait_item item = {
+		.e = e,
+		.index = index,
+	};
+
+	return switchtec_event_wait_set(dev, &item, 1, res, 0, timeout_ms);
 }
 
 /**@}*/
@@ -33,6 +33,7 @@
 #include "switchtec/switchtec.h"
 #include "switchtec/errors.h"
 #include "switchtec/endian.h"
+#include "switchtec/utils.h"
 
 #include <unistd.h>
 
@@ -157,6 +158,23 @@ struct cmd_fwdl {
 	uint8_t data[MRPC_MAX_DATA_LEN - sizeof(struct cmd_fwdl_hdr)];
 };
 
+/*
+ * Send the header and only the valid part of the data block. The
+ * firmware goes by blk_length, so there's no need to push the unused
+ * tail of a short final block over the wire.
+ */
+static int fw_dl_block(struct switchtec_dev *dev, struct cmd_fwdl *cmd,
+		       size_t blklen)
+{
+	struct switchtec_iovec iov[] = {
+		{ .iov_base = &cmd->hdr, .iov_len = sizeof(cmd->hdr) },
+		{ .iov_base = cmd->data, .iov_len = blklen },
+	};
+
+	return switchtec_cmdv(dev, MRPC_FWDNLD, iov, ARRAY_SIZE(iov),
+			      NULL, 0);
+}
+
 /**
  * @brief Write a firmware file to the switchtec device
  * @param[in] dev		Switchtec device handle
@@ -215,8 +233,7 @@ int switchtec_fw_write_fd(struct switchtec_dev *dev, int img_fd,
 		cmd.hdr.offset = htole32(offset);
 		cmd.hdr.blk_length = htole32(blklen);
 
-		ret = switchtec_cmd(dev, MRPC_FWDNLD, &cmd, sizeof(cmd),
-				    NULL, 0);
+		ret = fw_dl_block(dev, &cmd, blklen);
 
 		if (ret < 0)
 			return ret;
@@ -307,8 +324,7 @@ int switchtec_fw_write_file(struct switchtec_dev *dev, FILE *fimg,
 		cmd.hdr.offset = htole32(offset);
 		cmd.hdr.blk_length = htole32(blklen);
 
-		ret = switchtec_cmd(dev, MRPC_FWDNLD, &cmd, sizeof(cmd),
-				    NULL, 0);
+		ret = fw_dl_block(dev, &cmd, blklen);
 
 		if (ret < 0)
 			return ret;
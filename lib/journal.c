@@ -0,0 +1,185 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Bounded journal of events cleared by the event monitor
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+
+#include "switchtec/switchtec.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+/**
+ * @defgroup Journal Event Journal
+ * @ingroup Monitor
+ * @brief Record every event the monitor clears, with its data words
+ *
+ * A journal is a fixed size ring with a single producer, the thread
+ * calling switchtec_monitor_run(), and a single consumer calling
+ * switchtec_journal_next(). Neither side takes a lock or waits on the
+ * other. When the ring is full new entries are dropped and counted
+ * (see switchtec_journal_dropped()) rather than stalling the poller.
+ *
+ * @{
+ */
+
+#define JOURNAL_CACHELINE	64
+
+/*
+ * The producer and consumer indexes are kept on separate cache lines so
+ * the two threads don't bounce a line between them on every entry.
+ */
+struct switchtec_journal {
+	size_t mask;
+	struct switchtec_journal_entry *ring;
+
+	/* Only written by the producer */
+	char pad0[JOURNAL_CACHELINE];
+	size_t head;
+	unsigned long dropped;
+
+	/* Only written by the consumer */
+	char pad1[JOURNAL_CACHELINE];
+	size_t tail;
+};
+
+/**
+ * @brief Allocate an event journal
+ * @param[in] nr_entries	Minimum number of entries the journal holds
+ *	(rounded up to a power of two)
+ * @return The journal, or NULL on failure (with errno set)
+ *
+ * Attach it to a monitor with switchtec_monitor_set_journal().
+ */
+struct switchtec_journal *switchtec_journal_new(size_t nr_entries)
+{
+	struct switchtec_journal *j;
+	size_t size = 1;
+
+	if (!nr_entries) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	while (size < nr_entries)
+		size <<= 1;
+
+	j = calloc(1, sizeof(*j));
+	if (!j)
+		return NULL;
+
+	j->ring = calloc(size, sizeof(*j->ring));
+	if (!j->ring) {
+		free(j);
+		return NULL;
+	}
+
+	j->mask = size - 1;
+	return j;
+}
+
+/**
+ * @brief Free an event journal
+ * @param[in] journal	Journal to free
+ *
+ * It must first be detached from any monitor it was attached to.
+ */
+void switchtec_journal_free(struct switchtec_journal *journal)
+{
+	if (!journal)
+		return;
+
+	free(journal->ring);
+	free(journal);
+}
+
+/*
+ * Producer side, called by the monitor as it clears each event.
+ */
+void switchtec_journal_push(struct switchtec_journal *journal,
+			    const struct switchtec_event_record *rec)
+{
+	struct switchtec_journal_entry *entry;
+	size_t head, tail;
+
+	head = journal->head;
+	tail = __atomic_load_n(&journal->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail > journal->mask) {
+		__atomic_store_n(&journal->dropped, journal->dropped + 1,
+				 __ATOMIC_RELAXED);
+		return;
+	}
+
+	entry = &journal->ring[head & journal->mask];
+	entry->timestamp_ns = switchtec_stats_now();
+	entry->rec = *rec;
+
+	__atomic_store_n(&journal->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Take the oldest entry out of a journal
+ * @param[in]  journal	Journal to read
+ * @param[out] entry	Filled with the oldest entry
+ * @return 1 if an entry was returned, 0 if the journal is empty
+ *
+ * Call in a loop until it returns 0 to drain the journal. This may be
+ * done from a different thread than the one running the monitor, as
+ * long as only one thread reads a given journal.
+ */
+int switchtec_journal_next(struct switchtec_journal *journal,
+			   struct switchtec_journal_entry *entry)
+{
+	size_t head, tail;
+
+	tail = journal->tail;
+	head = __atomic_load_n(&journal->head, __ATOMIC_ACQUIRE);
+
+	if (tail == head)
+		return 0;
+
+	*entry = journal->ring[tail & journal->mask];
+
+	__atomic_store_n(&journal->tail, tail + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/**
+ * @brief Number of entries dropped because the journal was full
+ * @param[in] journal	Journal to query
+ * @return The number of entries dropped since the journal was created
+ */
+unsigned long switchtec_journal_dropped(struct switchtec_journal *journal)
+{
+	return __atomic_load_n(&journal->dropped, __ATOMIC_RELAXED);
+}
+
+/**@}*/
@@ -0,0 +1,429 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Monitor events on several switches at once
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+
+#include "switchtec/switchtec.h"
+#include "switchtec/utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+/**
+ * @defgroup Monitor Multi-Device Event Monitor
+ * @ingroup Event
+ * @brief Wait for events on a number of switches from a single thread
+ *
+ * switchtec_monitor_new() takes a list of open device handles. Handles
+ * whose backend can signal events through a file descriptor (the Linux
+ * kernel driver) are registered in a single epoll set. The rest are
+ * polled on a fixed interval. switchtec_monitor_run() then blocks until
+ * any of the switches reports events and hands each one to a callback,
+ * only reading the event summary of the devices that signalled.
+ *
+ * @{
+ */
+
+#define MONITOR_DEFAULT_POLL_MS		100
+#define MONITOR_MAX_READY		32
+#define MONITOR_MAX_DSP			47
+
+struct switchtec_monitor {
+	int nr_devs;
+	struct switchtec_dev **devs;
+	int *polled;
+	int nr_polled;
+	int poll_ms;
+	int epfd;
+	int swept;
+	int local_only;
+	struct switchtec_journal *journal;
+};
+
+static int monitor_elapsed_ms(uint64_t start)
+{
+	return (switchtec_stats_now() - start) / 1000000;
+}
+
+static int monitor_event_fd(struct switchtec_dev *dev)
+{
+	if (!dev->ops->event_fd)
+		return -1;
+
+	return dev->ops->event_fd(dev);
+}
+
+/*
+ * Enable the events of one of the local partition's ports. The PFF
+ * registers of unused ports may name another partition's function, so
+ * only arm it if it maps back to this partition.
+ */
+static void monitor_arm_port(struct switchtec_dev *dev, int port)
+{
+	int pff, part, p;
+	int e;
+
+	if (switchtec_port_to_pff(dev, -1, port, &pff))
+		return;
+
+	if (switchtec_pff_to_port(dev, pff, &part, &p) ||
+	    part != switchtec_partition(dev))
+		return;
+
+	for (e = 0; e < SWITCHTEC_MAX_EVENTS; e++)
+		if (switchtec_event_info(e, NULL, NULL) == SWITCHTEC_EVT_PFF)
+			switchtec_event_ctl(dev, e, pff,
+					    SWITCHTEC_EVT_FLAG_EN_POLL, NULL);
+}
+
+/*
+ * The kernel driver masks an event's interrupt after it fires, so every
+ * event that may be reported is enabled up front here and re-enabled as
+ * it's reported. Not every event exists on every switch, so errors are
+ * ignored.
+ */
+static void monitor_arm(struct switchtec_monitor *mon,
+			struct switchtec_dev *dev)
+{
+	int e, port;
+
+	if (!mon->local_only) {
+		for (e = 0; e < SWITCHTEC_MAX_EVENTS; e++)
+			switchtec_event_ctl(dev, e, SWITCHTEC_EVT_IDX_ALL,
+					    SWITCHTEC_EVT_FLAG_EN_POLL, NULL);
+		return;
+	}
+
+	for (e = 0; e < SWITCHTEC_MAX_EVENTS; e++)
+		if (switchtec_event_info(e, NULL, NULL) == SWITCHTEC_EVT_PART)
+			switchtec_event_ctl(dev, e, SWITCHTEC_EVT_IDX_LOCAL,
+					    SWITCHTEC_EVT_FLAG_EN_POLL, NULL);
+
+	monitor_arm_port(dev, 0);
+	monitor_arm_port(dev, SWITCHTEC_PFF_PORT_VEP);
+	for (port = 1; port <= MONITOR_MAX_DSP; port++)
+		monitor_arm_port(dev, port);
+}
+
+/**
+ * @brief Create a monitor for a set of devices
+ * @param[in] devs	Open device handles to monitor
+ * @param[in] nr_devs	Number of handles in \p devs
+ * @param[in] poll_ms	Polling interval for devices that can't signal
+ *	events (0 for the default of 100 ms)
+ * @return The monitor, or NULL on failure (with errno set)
+ *
+ * The handles must stay open until switchtec_monitor_free() is called.
+ */
+struct switchtec_monitor *switchtec_monitor_new(struct switchtec_dev **devs,
+						int nr_devs, int poll_ms)
+{
+	struct switchtec_monitor *mon;
+	int i, fd;
+
+	if (!devs || nr_devs <= 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	mon = calloc(1, sizeof(*mon));
+	if (!mon)
+		return NULL;
+
+	mon->epfd = -1;
+	mon->nr_devs = nr_devs;
+	mon->poll_ms = poll_ms > 0 ? poll_ms : MONITOR_DEFAULT_POLL_MS;
+	mon->devs = calloc(nr_devs, sizeof(*mon->devs));
+	mon->polled = calloc(nr_devs, sizeof(*mon->polled));
+	if (!mon->devs || !mon->polled)
+		goto err_free;
+
+#ifdef __linux__
+	mon->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (mon->epfd < 0)
+		goto err_free;
+#endif
+
+	for (i = 0; i < nr_devs; i++) {
+		mon->devs[i] = devs[i];
+
+		fd = monitor_event_fd(devs[i]);
+#ifdef __linux__
+		if (fd >= 0) {
+			struct epoll_event ev = {
+				.events = EPOLLPRI,
+				.data.u32 = i,
+			};
+
+			if (epoll_ctl(mon->epfd, EPOLL_CTL_ADD, fd, &ev))
+				goto err_free;
+
+			continue;
+		}
+#else
+		(void)fd;
+#endif
+		mon->polled[mon->nr_polled++] = i;
+	}
+
+	return mon;
+
+err_free:
+	switchtec_monitor_free(mon);
+	return NULL;
+}
+
+/**
+ * @brief Free a monitor created with switchtec_monitor_new()
+ * @param[in] mon	Monitor to free
+ *
+ * The device handles are not closed.
+ */
+void switchtec_monitor_free(struct switchtec_monitor *mon)
+{
+	if (!mon)
+		return;
+
+	if (mon->epfd >= 0)
+		close(mon->epfd);
+
+	free(mon->polled);
+	free(mon->devs);
+	free(mon);
+}
+
+/**
+ * @brief Record every event the monitor reports in a journal
+ * @param[in] mon	Monitor to attach the journal to
+ * @param[in] journal	Journal to write to, or NULL to detach
+ *
+ * Each event's timestamp, index, count and data words are pushed to the
+ * journal as the monitor clears it, before the callback is invoked.
+ */
+void switchtec_monitor_set_journal(struct switchtec_monitor *mon,
+				   struct switchtec_journal *journal)
+{
+	mon->journal = journal;
+}
+
+/**
+ * @brief Only report events in each device's own partition
+ * @param[in] mon		Monitor to configure
+ * @param[in] local_only	Non-zero to ignore global events and the
+ *	events of other partitions
+ *
+ * Events that are ignored are neither cleared nor re-enabled, so they
+ * are left for whichever host owns them. This must be called before
+ * the first call to switchtec_monitor_run().
+ */
+void switchtec_monitor_set_local(struct switchtec_monitor *mon,
+				 int local_only)
+{
+	mon->local_only = local_only;
+}
+
+/*
+ * Read one device's summary and report, clear and re-arm every event
+ * set in it that passes the partition filter.
+ */
+static int monitor_sweep(struct switchtec_monitor *mon, int i,
+			 switchtec_monitor_fn fn, void *arg)
+{
+	struct switchtec_event_record rec = {
+		.dev = mon->devs[i],
+		.dev_idx = i,
+	};
+	struct switchtec_event_summary sum;
+	struct switchtec_event_iter it;
+	int nr = 0;
+	int idx;
+	int ret;
+
+	ret = switchtec_event_summary(rec.dev, &sum);
+	if (ret)
+		return ret;
+
+	switchtec_event_iter_init(&it, &sum);
+	while (switchtec_event_iter_next(&it, &rec.eid, &idx)) {
+		rec.partition = -1;
+		rec.port = -1;
+
+		switch (switchtec_event_info(rec.eid, NULL, NULL)) {
+		case SWITCHTEC_EVT_GLOBAL:
+			break;
+		case SWITCHTEC_EVT_PART:
+			rec.partition = idx;
+			break;
+		case SWITCHTEC_EVT_PFF:
+			/*
+			 * A port function that isn't bound to a port is
+			 * still reported and cleared, just without one.
+			 */
+			if (switchtec_pff_to_port(rec.dev, idx,
+						  &rec.partition, &rec.port)) {
+				rec.partition = -1;
+				rec.port = -1;
+			}
+			break;
+		}
+
+		if (mon->local_only &&
+		    rec.partition != switchtec_partition(rec.dev))
+			continue;
+
+		rec.index = idx;
+		ret = switchtec_event_ctl(rec.dev, rec.eid, idx,
+					  SWITCHTEC_EVT_FLAG_CLEAR |
+					  SWITCHTEC_EVT_FLAG_EN_POLL,
+					  rec.data);
+		if (ret < 0)
+			return ret;
+
+		rec.count = ret;
+
+		if (mon->journal)
+			switchtec_journal_push(mon->journal, &rec);
+		if (fn)
+			fn(&rec, arg);
+		nr++;
+	}
+
+	return nr;
+}
+
+/**
+ * @brief Wait for events on any of the monitored devices
+ * @param[in] mon		Monitor to wait on
+ * @param[in] fn		Callback invoked once per event (may be NULL
+ *	if a journal is attached)
+ * @param[in] arg		Opaque argument passed to \p fn
+ * @param[in] timeout_ms	Give up after this many milliseconds
+ *	(negative to wait forever)
+ * @return The number of events reported, 0 on a timeout or a negative
+ *	value on an error (with errno set)
+ *
+ * The first call reports every event already pending on every device.
+ * Reported events are cleared so each occurrence is only seen once.
+ * Call this in a loop to follow events as they happen.
+ */
+int switchtec_monitor_run(struct switchtec_monitor *mon,
+			  switchtec_monitor_fn fn, void *arg, int timeout_ms)
+{
+	uint64_t start = switchtec_stats_now();
+	int nr = 0;
+	int wait_ms;
+	int ret;
+	int i;
+
+	if (!mon || (!fn && !mon->journal)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!mon->swept) {
+		mon->swept = 1;
+
+		for (i = 0; i < mon->nr_devs; i++) {
+			if (monitor_event_fd(mon->devs[i]) >= 0)
+				monitor_arm(mon, mon->devs[i]);
+
+			ret = monitor_sweep(mon, i, fn, arg);
+			if (ret < 0)
+				return ret;
+			nr += ret;
+		}
+
+		if (nr)
+			return nr;
+	}
+
+	while (1) {
+		wait_ms = -1;
+		if (timeout_ms >= 0) {
+			wait_ms = timeout_ms - monitor_elapsed_ms(start);
+			if (wait_ms < 0)
+				wait_ms = 0;
+		}
+
+		if (mon->nr_polled && (wait_ms < 0 || wait_ms > mon->poll_ms))
+			wait_ms = mon->poll_ms;
+
+#ifdef __linux__
+		{
+			struct epoll_event evs[MONITOR_MAX_READY];
+			int nr_ready;
+
+			nr_ready = epoll_wait(mon->epfd, evs, ARRAY_SIZE(evs),
+					      wait_ms);
+			if (nr_ready < 0 && errno == EINTR)
+				continue;
+			if (nr_ready < 0)
+				return -1;
+
+			for (i = 0; i < nr_ready; i++) {
+				if (evs[i].events & EPOLLERR) {
+					errno = ENODEV;
+					return -1;
+				}
+
+				ret = monitor_sweep(mon, evs[i].data.u32,
+						    fn, arg);
+				if (ret < 0)
+					return ret;
+				nr += ret;
+			}
+		}
+#else
+		if (wait_ms > 0)
+			usleep(wait_ms * 1000);
+#endif
+
+		for (i = 0; i < mon->nr_polled; i++) {
+			ret = monitor_sweep(mon, mon->polled[i], fn, arg);
+			if (ret < 0)
+				return ret;
+			nr += ret;
+		}
+
+		if (nr)
+			return nr;
+
+		if (timeout_ms >= 0 && monitor_elapsed_ms(start) >= timeout_ms)
+			return 0;
+	}
+}
+
+/**@}*/
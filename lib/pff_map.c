@@ -0,0 +1,301 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Per-handle table of port function to partition/port assignments
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+
+#include "switchtec/switchtec.h"
+#include "switchtec/utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PFF_MAP_CHECK_MS	100
+
+struct pff_map_counts {
+	int sys_reset;
+	int part_reset[SWITCHTEC_MAX_PARTS];
+	int part_bind[SWITCHTEC_MAX_PARTS];
+};
+
+/*
+ * Translating between a port function index and a (partition, port)
+ * pair means walking every partition's PFF instance registers, which
+ * is a lot of traffic over I2C or UART. Backends that can read all of
+ * them at once get a table with both directions that lookups are
+ * answered from. The Linux driver does the translation in a single
+ * ioctl, so it's left to do so.
+ *
+ * The assignments only change on a system reset, partition reset or
+ * dynamic partition binding. Before a lookup uses the table, the
+ * occurrence counts of those events are compared with the ones seen
+ * when it was built and it's rebuilt if any of them moved. The check
+ * is skipped for lookups within PFF_MAP_CHECK_MS of the last one so a
+ * burst of lookups only pays for it once.
+ */
+struct switchtec_pff_map {
+	pthread_mutex_t lock;
+	int valid;
+	int partition_count;
+
+	struct switchtec_part_pffs part[SWITCHTEC_MAX_PARTS];
+
+	/* -1 if the port function isn't assigned to any port */
+	int16_t pff_part[SWITCHTEC_MAX_PFF_CSR];
+	int16_t pff_port[SWITCHTEC_MAX_PFF_CSR];
+
+	struct pff_map_counts seen;
+	uint64_t checked_ns;
+};
+
+static struct switchtec_pff_map *pff_map_get(struct switchtec_dev *dev)
+{
+	struct switchtec_pff_map *map, *old = NULL;
+
+	map = __atomic_load_n(&dev->pff_map, __ATOMIC_ACQUIRE);
+	if (map)
+		return map;
+
+	map = calloc(1, sizeof(*map));
+	if (!map)
+		return NULL;
+
+	pthread_mutex_init(&map->lock, NULL);
+
+	if (!__atomic_compare_exchange_n(&dev->pff_map, &old, map, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_destroy(&map->lock);
+		free(map);
+		return old;
+	}
+
+	return map;
+}
+
+void switchtec_pff_map_free(struct switchtec_dev *dev)
+{
+	struct switchtec_pff_map *map = dev->pff_map;
+
+	if (!map)
+		return;
+
+	dev->pff_map = NULL;
+	pthread_mutex_destroy(&map->lock);
+	free(map);
+}
+
+/*
+ * Events that aren't implemented on a switch read back as an error
+ * every time, which compares equal just the same.
+ */
+static void pff_map_read_counts(struct switchtec_dev *dev, int nr_parts,
+				struct pff_map_counts *c)
+{
+	int part;
+
+	memset(c, 0, sizeof(*c));
+
+	c->sys_reset = dev->ops->event_ctl(dev, SWITCHTEC_GLOBAL_EVT_SYS_RESET,
+					   0, 0, NULL);
+
+	for (part = 0; part < nr_parts; part++) {
+		c->part_reset[part] =
+			dev->ops->event_ctl(dev, SWITCHTEC_PART_EVT_PART_RESET,
+					    part, 0, NULL);
+		c->part_bind[part] =
+			dev->ops->event_ctl(dev,
+					    SWITCHTEC_PART_EVT_DYN_PART_BIND_COMP,
+					    part, 0, NULL);
+	}
+}
+
+/*
+ * The first assignment found wins, in the same order the backends
+ * search: by partition, then upstream port, VEP and downstream ports.
+ */
+static void pff_map_add(struct switchtec_pff_map *map, uint32_t pff,
+			int partition, int port)
+{
+	if (pff >= SWITCHTEC_MAX_PFF_CSR || map->pff_part[pff] >= 0)
+		return;
+
+	map->pff_part[pff] = partition;
+	map->pff_port[pff] = port;
+}
+
+static int pff_map_build(struct switchtec_dev *dev,
+			 struct switchtec_pff_map *map)
+{
+	int nr_parts = dev->partition_count;
+	struct switchtec_part_pffs *p;
+	int part, i;
+	int ret;
+
+	if (nr_parts <= 0 || nr_parts > SWITCHTEC_MAX_PARTS) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	/* Read first so a change while building is caught next time */
+	pff_map_read_counts(dev, nr_parts, &map->seen);
+	map->checked_ns = switchtec_stats_now();
+
+	ret = dev->ops->part_pffs(dev, map->part, nr_parts);
+	if (ret)
+		return ret;
+
+	memset(map->pff_part, 0xff, sizeof(map->pff_part));
+	memset(map->pff_port, 0xff, sizeof(map->pff_port));
+
+	for (part = 0; part < nr_parts; part++) {
+		p = &map->part[part];
+
+		pff_map_add(map, p->usp, part, 0);
+		pff_map_add(map, p->vep, part, SWITCHTEC_PFF_PORT_VEP);
+		for (i = 0; i < ARRAY_SIZE(p->dsp); i++)
+			pff_map_add(map, p->dsp[i], part, i + 1);
+	}
+
+	map->partition_count = nr_parts;
+	map->valid = 1;
+
+	return 0;
+}
+
+static void pff_map_check(struct switchtec_dev *dev,
+			  struct switchtec_pff_map *map)
+{
+	struct pff_map_counts now;
+	uint64_t now_ns = switchtec_stats_now();
+
+	if (now_ns - map->checked_ns < PFF_MAP_CHECK_MS * 1000000ULL)
+		return;
+
+	pff_map_read_counts(dev, map->partition_count, &now);
+	map->checked_ns = now_ns;
+
+	if (memcmp(&now, &map->seen, sizeof(now)))
+		map->valid = 0;
+}
+
+/*
+ * Lock the table, building or rebuilding it first if need be. Returns
+ * NULL if there's no table for this backend or it can't be built, in
+ * which case the caller asks the backend directly.
+ */
+static struct switchtec_pff_map *pff_map_lock(struct switchtec_dev *dev)
+{
+	struct switchtec_pff_map *map;
+
+	if (!dev->ops->part_pffs)
+		return NULL;
+
+	map = pff_map_get(dev);
+	if (!map)
+		return NULL;
+
+	pthread_mutex_lock(&map->lock);
+
+	if (map->valid)
+		pff_map_check(dev, map);
+
+	if (!map->valid && pff_map_build(dev, map)) {
+		pthread_mutex_unlock(&map->lock);
+		return NULL;
+	}
+
+	return map;
+}
+
+int switchtec_pff_map_to_port(struct switchtec_dev *dev, int pff,
+			      int *partition, int *port)
+{
+	struct switchtec_pff_map *map;
+	int ret = 0;
+
+	map = pff_map_lock(dev);
+	if (!map)
+		return dev->ops->pff_to_port(dev, pff, partition, port);
+
+	if (pff < 0 || pff >= SWITCHTEC_MAX_PFF_CSR ||
+	    map->pff_part[pff] < 0) {
+		if (port)
+			*port = -1;
+		errno = EINVAL;
+		ret = -EINVAL;
+	} else {
+		if (partition)
+			*partition = map->pff_part[pff];
+		if (port)
+			*port = map->pff_port[pff];
+	}
+
+	pthread_mutex_unlock(&map->lock);
+	return ret;
+}
+
+int switchtec_pff_map_to_pff(struct switchtec_dev *dev, int partition,
+			     int port, int *pff)
+{
+	struct switchtec_pff_map *map;
+	struct switchtec_part_pffs *p;
+	int ret = 0;
+
+	map = pff_map_lock(dev);
+	if (!map)
+		return dev->ops->port_to_pff(dev, partition, port, pff);
+
+	if (partition < 0)
+		partition = dev->partition;
+
+	if (partition < 0 || partition >= map->partition_count) {
+		errno = EINVAL;
+		ret = -EINVAL;
+		goto out;
+	}
+
+	p = &map->part[partition];
+
+	if (port == 0) {
+		*pff = p->usp;
+	} else if (port == SWITCHTEC_PFF_PORT_VEP) {
+		*pff = p->vep;
+	} else if (port > 0 && port <= ARRAY_SIZE(p->dsp)) {
+		*pff = p->dsp[port - 1];
+	} else {
+		errno = EINVAL;
+		ret = -EINVAL;
+	}
+
+out:
+	pthread_mutex_unlock(&map->lock);
+	return ret;
+}
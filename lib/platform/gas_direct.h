@@ -0,0 +1,109 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief GAS accessors for when the GAS is mapped into our address space
+ */
+
+#ifndef LIBSWITCHTEC_GAS_DIRECT_H
+#define LIBSWITCHTEC_GAS_DIRECT_H
+
+#include "../switchtec_priv.h"
+#include "switchtec/gas.h"
+
+#ifdef __CHECKER__
+#define __force __attribute__((force))
+#else
+#define __force
+#endif
+
+/*
+ * When the backend has the GAS mapped (Linux and Windows) register
+ * accesses are single volatile loads and stores, so there's no need
+ * to call through the backend's ops table for them.
+ */
+#define create_gas_direct(type, suffix) \
+	static inline type gas_read ## suffix ## _direct(type __gas *addr) \
+	{ \
+		asm volatile("": : :"memory"); \
+		return *(volatile type __force *)addr; \
+	} \
+	static inline void gas_write ## suffix ## _direct(type val, \
+							 type __gas *addr) \
+	{ \
+		asm volatile("": : :"memory"); \
+		*(volatile type __force *)addr = val; \
+	}
+
+create_gas_direct(uint8_t, 8)
+create_gas_direct(uint16_t, 16)
+create_gas_direct(uint32_t, 32)
+create_gas_direct(uint64_t, 64)
+
+#undef create_gas_direct
+#undef __force
+
+#ifndef SWITCHTEC_GAS_NO_INLINE
+
+/*
+ * Library code including this header gets the direct access inlined;
+ * everything else is left to the exported functions.
+ */
+#define create_gas_inline(type, suffix) \
+	static inline type gas_read ## suffix ## _inline( \
+		struct switchtec_dev *dev, type __gas *addr) \
+	{ \
+		if (dev->gas_direct) \
+			return gas_read ## suffix ## _direct(addr); \
+		return gas_read ## suffix(dev, addr); \
+	} \
+	static inline void gas_write ## suffix ## _inline( \
+		struct switchtec_dev *dev, type val, type __gas *addr) \
+	{ \
+		if (dev->gas_direct) \
+			gas_write ## suffix ## _direct(val, addr); \
+		else \
+			gas_write ## suffix(dev, val, addr); \
+	}
+
+create_gas_inline(uint8_t, 8)
+create_gas_inline(uint16_t, 16)
+create_gas_inline(uint32_t, 32)
+create_gas_inline(uint64_t, 64)
+
+#undef create_gas_inline
+
+#define gas_read8(dev, addr)		gas_read8_inline(dev, addr)
+#define gas_read16(dev, addr)		gas_read16_inline(dev, addr)
+#define gas_read32(dev, addr)		gas_read32_inline(dev, addr)
+#define gas_read64(dev, addr)		gas_read64_inline(dev, addr)
+#define gas_write8(dev, val, addr)	gas_write8_inline(dev, val, addr)
+#define gas_write16(dev, val, addr)	gas_write16_inline(dev, val, addr)
+#define gas_write32(dev, val, addr)	gas_write32_inline(dev, val, addr)
+#define gas_write64(dev, val, addr)	gas_write64_inline(dev, val, addr)
+
+#endif
+
+#endif
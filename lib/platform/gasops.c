@@ -26,12 +26,15 @@
 #include "switchtec/gas.h"
 #include "../switchtec_priv.h"
 #include "switchtec/utils.h"
+#include "gas_direct.h"
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/time.h>
 
 #define gas_reg_read8(dev, reg)  gas_read8(dev, &dev->gas_map->reg)
 #define gas_reg_read16(dev, reg) gas_read16(dev, &dev->gas_map->reg)
@@ -47,6 +50,312 @@
 #define gas_reg_write64(dev, val, reg) gas_write64(dev, val, \
 						   &dev->gas_map->reg)
 
+#define GASOP_BATCH_MAX_XFER 1024
+
+#ifdef __CHECKER__
+#define __force __attribute__((force))
+#else
+#define __force
+#endif
+
+static uintptr_t req_addr(const struct gas_read_req *r)
+{
+	return (uintptr_t)(const void __force *)r->addr;
+}
+
+#undef __force
+
+/*
+ * Sorts an index of the requests by address. The helpers below build
+ * their batches mostly in order already, which insertion sort likes.
+ */
+static void batch_sort(const struct gas_read_req *reqs, size_t *order,
+		       size_t n)
+{
+	size_t i, j, t;
+
+	for (i = 0; i < n; i++)
+		order[i] = i;
+
+	for (i = 1; i < n; i++) {
+		t = order[i];
+		for (j = i; j && req_addr(&reqs[order[j - 1]]) >
+			     req_addr(&reqs[t]); j--)
+			order[j] = order[j - 1];
+		order[j] = t;
+	}
+}
+
+/**
+ * @brief Coalescing gas_read_batch() for transports with a high cost
+ *	per transaction
+ * @param[in] dev	Switchtec device handle
+ * @param[in] reqs	Reads to perform
+ * @param[in] n		Number of entries in \p reqs
+ * @param[in] max_gap	Largest number of unrequested bytes worth reading
+ *			to join two reads into one transfer
+ * @param[in] max_xfer	Largest transfer to build
+ *
+ * Reads whose addresses fall within \p max_gap of each other are merged
+ * into a single memcpy_from_gas() of up to \p max_xfer bytes and the
+ * results are copied out to each request's buffer.
+ */
+void gasop_read_batch(struct switchtec_dev *dev,
+		      const struct gas_read_req *reqs, size_t n,
+		      size_t max_gap, size_t max_xfer)
+{
+	uint8_t buf[GASOP_BATCH_MAX_XFER];
+	size_t order_buf[64], *order = order_buf;
+	const struct gas_read_req *r;
+	uintptr_t start, end;
+	size_t i, j;
+
+	if (max_xfer > sizeof(buf))
+		max_xfer = sizeof(buf);
+
+	if (n > ARRAY_SIZE(order_buf)) {
+		order = malloc(n * sizeof(*order));
+		if (!order) {
+			for (i = 0; i < n; i++)
+				memcpy_from_gas(dev, reqs[i].dest,
+						reqs[i].addr, reqs[i].len);
+			return;
+		}
+	}
+
+	batch_sort(reqs, order, n);
+
+	for (i = 0; i < n; i = j) {
+		r = &reqs[order[i]];
+		start = req_addr(r);
+		end = start + r->len;
+
+		if (r->len > max_xfer) {
+			memcpy_from_gas(dev, r->dest, r->addr, r->len);
+			j = i + 1;
+			continue;
+		}
+
+		for (j = i + 1; j < n; j++) {
+			r = &reqs[order[j]];
+			if (req_addr(r) > end + max_gap)
+				break;
+			if (req_addr(r) + r->len > end) {
+				if (req_addr(r) + r->len - start > max_xfer)
+					break;
+				end = req_addr(r) + r->len;
+			}
+		}
+
+		memcpy_from_gas(dev, buf, reqs[order[i]].addr, end - start);
+
+		for (; i < j; i++) {
+			r = &reqs[order[i]];
+			memcpy(r->dest, &buf[req_addr(r) - start], r->len);
+		}
+	}
+
+	if (order != order_buf)
+		free(order);
+}
+
+#define GAS_RCACHE_BLOCK	256
+#define GAS_RCACHE_BLOCKS	64
+#define GAS_RCACHE_TTL_US	100000
+#define GAS_RCACHE_INVALID	((size_t)-1)
+
+struct gasop_rcache {
+	pthread_mutex_t lock;
+	struct {
+		size_t addr;
+		long long filled_us;
+		uint8_t data[GAS_RCACHE_BLOCK];
+	} blk[GAS_RCACHE_BLOCKS];
+};
+
+static long long now_us(void)
+{
+	return switchtec_stats_now() / 1000;
+}
+
+/*
+ * Returns true if [off, end) touches the range [vstart, vend) within any
+ * of the count entries of stride bytes starting at base.
+ */
+static bool rcache_hits_entries(size_t off, size_t end, size_t base,
+				size_t stride, size_t count,
+				size_t vstart, size_t vend)
+{
+	size_t i, first, last, limit = base + stride * count;
+
+	if (end <= base || off >= limit)
+		return false;
+
+	first = off < base ? 0 : (off - base) / stride;
+	last = ((end < limit ? end : limit) - 1 - base) / stride;
+
+	for (i = first; i <= last; i++)
+		if (off < base + i * stride + vend &&
+		    end > base + i * stride + vstart)
+			return true;
+
+	return false;
+}
+
+/*
+ * Registers the switch or the firmware change behind our back: the MRPC
+ * region, the switch event registers, NTB doorbells and messages and the
+ * event summaries and headers of every partition and PFF.
+ */
+static bool rcache_volatile(size_t off, size_t len)
+{
+	size_t end = off + len;
+
+	if (off < SWITCHTEC_GAS_TOP_CFG_OFFSET)
+		return true;
+
+	if (off < SWITCHTEC_GAS_SYS_INFO_OFFSET &&
+	    end > SWITCHTEC_GAS_SW_EVENT_OFFSET)
+		return true;
+
+	if (off < SWITCHTEC_GAS_PFF_CSR_OFFSET &&
+	    end > SWITCHTEC_GAS_NTB_OFFSET)
+		return true;
+
+	if (rcache_hits_entries(off, end, SWITCHTEC_GAS_PART_CFG_OFFSET,
+			sizeof(struct part_cfg_regs),
+			SWITCHTEC_MAX_PARTITIONS,
+			offsetof(struct part_cfg_regs, port_event_bitmap),
+			sizeof(struct part_cfg_regs)))
+		return true;
+
+	return rcache_hits_entries(off, end, SWITCHTEC_GAS_PFF_CSR_OFFSET,
+			sizeof(struct pff_csr_regs), SWITCHTEC_MAX_PFF_CSR,
+			offsetof(struct pff_csr_regs, pff_event_summary),
+			sizeof(struct pff_csr_regs));
+}
+
+/**
+ * @brief Enable or disable the handle's GAS read-ahead cache
+ * @param[in] dev	Switchtec device handle
+ * @param[in] enable	Non-zero to enable
+ * @return 0 on success, negative on failure
+ *
+ * Backends using this route their memcpy_from_gas() through
+ * gasop_rcache_read() and call gasop_rcache_invalidate() after every
+ * write.
+ */
+int gasop_gas_readahead(struct switchtec_dev *dev, int enable)
+{
+	struct gasop_rcache *rc = dev->rcache;
+	int i;
+
+	if (!enable) {
+		if (!rc)
+			return 0;
+
+		dev->rcache = NULL;
+		pthread_mutex_destroy(&rc->lock);
+		free(rc);
+		return 0;
+	}
+
+	if (rc)
+		return 0;
+
+	rc = malloc(sizeof(*rc));
+	if (!rc)
+		return -errno;
+
+	pthread_mutex_init(&rc->lock, NULL);
+	for (i = 0; i < GAS_RCACHE_BLOCKS; i++)
+		rc->blk[i].addr = GAS_RCACHE_INVALID;
+
+	dev->rcache = rc;
+	return 0;
+}
+
+void gasop_rcache_invalidate(struct switchtec_dev *dev)
+{
+	struct gasop_rcache *rc = dev->rcache;
+	int i;
+
+	if (!rc)
+		return;
+
+	pthread_mutex_lock(&rc->lock);
+	for (i = 0; i < GAS_RCACHE_BLOCKS; i++)
+		rc->blk[i].addr = GAS_RCACHE_INVALID;
+	pthread_mutex_unlock(&rc->lock);
+}
+
+/**
+ * @brief Read from the GAS through the handle's read-ahead cache
+ * @param[in]  dev	Switchtec device handle
+ * @param[out] dest	Destination buffer
+ * @param[in]  src	Source GAS address
+ * @param[in]  n	Number of bytes to read
+ * @param[in]  raw	The backend's uncached memcpy_from_gas()
+ *
+ * Misses fetch the whole aligned block around the read. Reads of a block
+ * or more, and reads of volatile registers, go straight to the device.
+ */
+void gasop_rcache_read(struct switchtec_dev *dev, void *dest,
+		       const void __gas *src, size_t n,
+		       void (*raw)(struct switchtec_dev *dev, void *dest,
+				   const void __gas *src, size_t n))
+{
+	struct gasop_rcache *rc = dev->rcache;
+	const char __gas *s = src;
+	uint8_t *d = dest;
+	size_t off = s - (const char __gas *)dev->gas_map;
+	size_t blk_off, cnt;
+	long long now;
+	int i;
+
+	if (!rc || n >= GAS_RCACHE_BLOCK || rcache_volatile(off, n)) {
+		raw(dev, dest, src, n);
+		return;
+	}
+
+	pthread_mutex_lock(&rc->lock);
+	now = now_us();
+
+	while (n) {
+		blk_off = off & ~((size_t)GAS_RCACHE_BLOCK - 1);
+		cnt = blk_off + GAS_RCACHE_BLOCK - off;
+		if (cnt > n)
+			cnt = n;
+
+		i = (blk_off / GAS_RCACHE_BLOCK) % GAS_RCACHE_BLOCKS;
+
+		if (rc->blk[i].addr != blk_off ||
+		    now - rc->blk[i].filled_us > GAS_RCACHE_TTL_US) {
+			if (blk_off + GAS_RCACHE_BLOCK > dev->gas_map_size ||
+			    rcache_volatile(blk_off, GAS_RCACHE_BLOCK)) {
+				raw(dev, d, s, cnt);
+				goto next;
+			}
+
+			raw(dev, rc->blk[i].data,
+			    (const char __gas *)dev->gas_map + blk_off,
+			    GAS_RCACHE_BLOCK);
+			rc->blk[i].addr = blk_off;
+			rc->blk[i].filled_us = now;
+		}
+
+		memcpy(d, &rc->blk[i].data[off - blk_off], cnt);
+
+next:
+		d += cnt;
+		s += cnt;
+		off += cnt;
+		n -= cnt;
+	}
+
+	pthread_mutex_unlock(&rc->lock);
+}
+
 int gasop_access_check(struct switchtec_dev *dev)
 {
 	uint32_t device_id;
@@ -59,29 +368,181 @@ int gasop_access_check(struct switchtec_dev *dev)
 
 void gasop_set_partition_info(struct switchtec_dev *dev)
 {
-	dev->partition = gas_reg_read8(dev, top.partition_id);
-	dev->partition_count = gas_reg_read8(dev, top.partition_count);
+	uint8_t partition, count;
+	struct gas_read_req reqs[] = {
+		GAS_READ_REQ(&dev->gas_map->top.partition_id, &partition),
+		GAS_READ_REQ(&dev->gas_map->top.partition_count, &count),
+	};
+
+	gas_read_batch(dev, reqs, ARRAY_SIZE(reqs));
+
+	dev->partition = partition;
+	dev->partition_count = count;
 }
 
-int gasop_cmd(struct switchtec_dev *dev, uint32_t cmd,
-	      const void *payload, size_t payload_len, void *resp,
-	      size_t resp_len)
+/*
+ * Parameters for each MRPC polling policy. After issuing a command we
+ * first sleep for a percentage of the latency previously observed for
+ * that command ID, then poll the status register back to back a few
+ * times before backing off exponentially between polls.
+ */
+static const struct mrpc_poll_params {
+	unsigned presleep_pct;
+	unsigned spin_polls;
+	unsigned min_sleep_us;
+	unsigned max_sleep_us;
+} mrpc_poll_params[] = {
+	[SWITCHTEC_MRPC_POLL_BALANCED] = {
+		.presleep_pct = 50,
+		.spin_polls = 8,
+		.min_sleep_us = 10,
+		.max_sleep_us = 5000,
+	},
+	[SWITCHTEC_MRPC_POLL_LATENCY] = {
+		.presleep_pct = 0,
+		.spin_polls = 64,
+		.min_sleep_us = 1,
+		.max_sleep_us = 1000,
+	},
+	[SWITCHTEC_MRPC_POLL_LOW_CPU] = {
+		.presleep_pct = 90,
+		.spin_polls = 0,
+		.min_sleep_us = 100,
+		.max_sleep_us = 5000,
+	},
+};
+
+static unsigned *mrpc_lat_entry(struct switchtec_dev *dev, uint32_t cmd)
+{
+	return &dev->mrpc_lat_us[(cmd & SWITCHTEC_CMD_MASK) %
+				 MRPC_LAT_TBL_SIZE];
+}
+
+/*
+ * done_us is our best estimate of when the command completed, which
+ * doesn't include any time spent sleeping after it did.
+ */
+static void mrpc_learn_latency(struct switchtec_dev *dev, long long done_us)
+{
+	unsigned *lat = mrpc_lat_entry(dev, dev->mrpc_cmd);
+	long long elapsed;
+
+	if (!dev->mrpc_submit_us)
+		return;
+
+	elapsed = done_us - dev->mrpc_submit_us;
+	if (elapsed < 0)
+		elapsed = 0;
+
+	/* Exponentially weighted moving average with a weight of 1/8 */
+	if (*lat)
+		*lat = (*lat * 7 + elapsed) / 8;
+	else
+		*lat = elapsed;
+
+	dev->mrpc_submit_us = 0;
+}
+
+/*
+ * Wait for the outstanding MRPC command to leave the INPROGRESS state.
+ * Returns the last status read which will still be INPROGRESS if
+ * timeout_ms expired first. A negative timeout waits forever.
+ */
+static int mrpc_wait_status(struct switchtec_dev *dev, int timeout_ms)
 {
+	const struct mrpc_poll_params *p;
 	struct mrpc_regs __gas *mrpc = &dev->gas_map->mrpc;
+	unsigned lat = *mrpc_lat_entry(dev, dev->mrpc_cmd);
+	unsigned delay, polls = 0;
+	long long now, presleep, deadline = -1;
+	long long busy_us, read_us;
 	int status;
-	int ret;
 
-	memcpy_to_gas(dev, &mrpc->input_data, payload, payload_len);
-	gas_write32(dev, cmd, &mrpc->cmd);
+	p = &mrpc_poll_params[dev->mrpc_poll_policy];
+	delay = p->min_sleep_us;
+	now = now_us();
 
-	while (1) {
-		usleep(5000);
+	if (timeout_ms >= 0)
+		deadline = now + timeout_ms * 1000LL;
+
+	if (dev->mrpc_submit_us && lat && p->presleep_pct) {
+		presleep = dev->mrpc_submit_us + lat * p->presleep_pct / 100;
+		if (deadline >= 0 && presleep > deadline)
+			presleep = deadline;
+		if (presleep > now)
+			usleep(presleep - now);
+	}
 
+	/*
+	 * The command completed somewhere between the last poll that saw
+	 * it in progress and the one that didn't. Learn the midpoint so
+	 * that time slept past completion doesn't inflate the estimate.
+	 */
+	busy_us = dev->mrpc_submit_us;
+
+	while (1) {
+		read_us = now_us();
 		status = gas_read32(dev, &mrpc->status);
 		if (status != SWITCHTEC_MRPC_STATUS_INPROGRESS)
 			break;
+
+		busy_us = read_us;
+
+		/* A zero timeout only gets the one read */
+		if (timeout_ms != 0 && polls++ < p->spin_polls)
+			continue;
+
+		if (deadline >= 0) {
+			now = now_us();
+			if (now >= deadline)
+				return status;
+			if (now + delay > deadline)
+				delay = deadline - now;
+		}
+
+		usleep(delay);
+		delay *= 2;
+		if (delay > p->max_sleep_us)
+			delay = p->max_sleep_us;
 	}
 
+	if (status == SWITCHTEC_MRPC_STATUS_DONE)
+		mrpc_learn_latency(dev, busy_us + (read_us - busy_us) / 2);
+
+	return status;
+}
+
+static void mrpc_submitv(struct switchtec_dev *dev, uint32_t cmd,
+			 const struct switchtec_iovec *payload,
+			 int payload_cnt)
+{
+	struct mrpc_regs __gas *mrpc = &dev->gas_map->mrpc;
+	size_t off = 0;
+	int i;
+
+	for (i = 0; i < payload_cnt; i++) {
+		memcpy_to_gas(dev, &mrpc->input_data[off],
+			      payload[i].iov_base, payload[i].iov_len);
+		off += payload[i].iov_len;
+	}
+
+	gas_write32(dev, cmd, &mrpc->cmd);
+
+	dev->mrpc_cmd = cmd;
+	dev->mrpc_submit_us = now_us();
+}
+
+static int mrpc_completev(struct switchtec_dev *dev,
+			  const struct switchtec_iovec *resp, int resp_cnt)
+{
+	struct mrpc_regs __gas *mrpc = &dev->gas_map->mrpc;
+	size_t off = 0;
+	int status;
+	int ret;
+	int i;
+
+	status = mrpc_wait_status(dev, -1);
+
 	if (status == SWITCHTEC_MRPC_STATUS_INTERRUPTED) {
 		errno = ENXIO;
 		return -errno;
@@ -96,12 +557,81 @@ int gasop_cmd(struct switchtec_dev *dev, uint32_t cmd,
 	if (ret)
 		errno = ret;
 
-	if(resp)
-		memcpy_from_gas(dev, resp, &mrpc->output_data, resp_len);
+	for (i = 0; i < resp_cnt; i++) {
+		memcpy_from_gas(dev, resp[i].iov_base, &mrpc->output_data[off],
+				resp[i].iov_len);
+		off += resp[i].iov_len;
+	}
 
 	return ret;
 }
 
+int gasop_cmd_submit(struct switchtec_dev *dev, uint32_t cmd,
+		     const void *payload, size_t payload_len)
+{
+	struct switchtec_iovec iov = {
+		.iov_base = (void *)payload,
+		.iov_len = payload_len,
+	};
+
+	if (payload_len > SWITCHTEC_MRPC_PAYLOAD_SIZE) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	mrpc_submitv(dev, cmd, &iov, 1);
+
+	return 0;
+}
+
+int gasop_cmd_poll(struct switchtec_dev *dev, int timeout_ms)
+{
+	return mrpc_wait_status(dev, timeout_ms) !=
+		SWITCHTEC_MRPC_STATUS_INPROGRESS;
+}
+
+int gasop_cmd_complete(struct switchtec_dev *dev, void *resp,
+		       size_t resp_len)
+{
+	struct switchtec_iovec iov = {
+		.iov_base = resp,
+		.iov_len = resp_len,
+	};
+
+	return mrpc_completev(dev, &iov, resp ? 1 : 0);
+}
+
+int gasop_cmdv(struct switchtec_dev *dev, uint32_t cmd,
+	       const struct switchtec_iovec *payload, int payload_cnt,
+	       const struct switchtec_iovec *resp, int resp_cnt)
+{
+	if (iov_total_len(payload, payload_cnt) > SWITCHTEC_MRPC_PAYLOAD_SIZE ||
+	    iov_total_len(resp, resp_cnt) > SWITCHTEC_MRPC_PAYLOAD_SIZE) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	mrpc_submitv(dev, cmd, payload, payload_cnt);
+
+	return mrpc_completev(dev, resp, resp_cnt);
+}
+
+int gasop_cmd(struct switchtec_dev *dev, uint32_t cmd,
+	      const void *payload, size_t payload_len, void *resp,
+	      size_t resp_len)
+{
+	struct switchtec_iovec piov = {
+		.iov_base = (void *)payload,
+		.iov_len = payload_len,
+	};
+	struct switchtec_iovec riov = {
+		.iov_base = resp,
+		.iov_len = resp_len,
+	};
+
+	return gasop_cmdv(dev, cmd, &piov, 1, &riov, resp ? 1 : 0);
+}
+
 int gasop_get_device_id(struct switchtec_dev *dev)
 {
 	return gas_reg_read32(dev, sys_info.device_id);
@@ -122,8 +652,10 @@ int gasop_pff_to_port(struct switchtec_dev *dev, int pff,
 		      int *partition, int *port)
 {
 	int i, part;
-	uint32_t reg;
+	uint32_t usp, vep, dsp[ARRAY_SIZE(dev->gas_map->part_cfg[0].
+					    dsp_pff_inst_id)];
 	struct part_cfg_regs __gas *pcfg;
+	struct gas_read_req reqs[3];
 
 	*port = -1;
 
@@ -131,21 +663,27 @@ int gasop_pff_to_port(struct switchtec_dev *dev, int pff,
 		pcfg = &dev->gas_map->part_cfg[part];
 		*partition = part;
 
-		reg = gas_read32(dev, &pcfg->usp_pff_inst_id);
-		if (reg == pff) {
+		reqs[0] = (struct gas_read_req)
+			GAS_READ_REQ(&pcfg->usp_pff_inst_id, &usp);
+		reqs[1] = (struct gas_read_req)
+			GAS_READ_REQ(&pcfg->vep_pff_inst_id, &vep);
+		reqs[2] = (struct gas_read_req)
+			GAS_READ_REQ(&pcfg->dsp_pff_inst_id, &dsp);
+
+		gas_read_batch(dev, reqs, ARRAY_SIZE(reqs));
+
+		if (usp == pff) {
 			*port = 0;
 			return 0;
 		}
 
-		reg = gas_read32(dev, &pcfg->vep_pff_inst_id);
-		if (reg == pff) {
+		if (vep == pff) {
 			*port = SWITCHTEC_PFF_PORT_VEP;
 			return 0;
 		}
 
-		for (i = 0; i < ARRAY_SIZE(pcfg->dsp_pff_inst_id); i++) {
-			reg = gas_read32(dev, &pcfg->dsp_pff_inst_id[i]);
-			if (reg != pff)
+		for (i = 0; i < ARRAY_SIZE(dsp); i++) {
+			if (dsp[i] != pff)
 				continue;
 
 			*port = i + 1;
@@ -160,6 +698,33 @@ int gasop_pff_to_port(struct switchtec_dev *dev, int pff,
 	return -EINVAL;
 }
 
+int gasop_part_pffs(struct switchtec_dev *dev,
+		    struct switchtec_part_pffs *parts, int nr_parts)
+{
+	struct gas_read_req reqs[3 * SWITCHTEC_MAX_PARTS];
+	struct part_cfg_regs __gas *pcfg;
+	int part, n = 0;
+
+	if (nr_parts > SWITCHTEC_MAX_PARTS) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	for (part = 0; part < nr_parts; part++) {
+		pcfg = &dev->gas_map->part_cfg[part];
+
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(&pcfg->usp_pff_inst_id, &parts[part].usp);
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(&pcfg->vep_pff_inst_id, &parts[part].vep);
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(&pcfg->dsp_pff_inst_id, &parts[part].dsp);
+	}
+
+	gas_read_batch(dev, reqs, n);
+	return 0;
+}
+
 int gasop_port_to_pff(struct switchtec_dev *dev, int partition,
 		      int port, int *pff)
 {
@@ -194,101 +759,158 @@ int gasop_port_to_pff(struct switchtec_dev *dev, int partition,
 	return 0;
 }
 
-static void set_fw_info_part(struct switchtec_dev *dev,
-			     struct switchtec_fw_image_info *info,
-			     struct partition_info __gas *pi)
-{
-	info->image_addr = gas_read32(dev, &pi->address);
-	info->image_len = gas_read32(dev, &pi->length);
-}
-
 int gasop_flash_part(struct switchtec_dev *dev,
 		     struct switchtec_fw_image_info *info,
 		     enum switchtec_fw_image_type part)
 {
 	struct flash_info_regs __gas *fi = &dev->gas_map->flash_info;
 	struct sys_info_regs __gas *si = &dev->gas_map->sys_info;
+	struct partition_info __gas *pi;
+	uint32_t __gas *active_reg = NULL;
+	uint16_t __gas *running_reg = NULL;
+	uint16_t running_val = 0, val = 0;
 	uint32_t active_addr = -1;
-	int val;
+	uint32_t addr, len;
+	struct gas_read_req reqs[4];
+	int n = 0;
 
 	memset(info, 0, sizeof(*info));
 
 	switch (part) {
 	case SWITCHTEC_FW_TYPE_IMG0:
-		active_addr = gas_read32(dev, &fi->active_img.address);
-		set_fw_info_part(dev, info, &fi->img0);
-
-		val = gas_read16(dev, &si->img_running);
-		if (val == SWITCHTEC_IMG0_RUNNING)
-			info->active |= SWITCHTEC_FW_PART_RUNNING;
+		pi = &fi->img0;
+		active_reg = &fi->active_img.address;
+		running_reg = &si->img_running;
+		running_val = SWITCHTEC_IMG0_RUNNING;
 		break;
-
 	case SWITCHTEC_FW_TYPE_IMG1:
-		active_addr = gas_read32(dev, &fi->active_img.address);
-		set_fw_info_part(dev, info, &fi->img1);
-
-		val = gas_read16(dev, &si->img_running);
-		if (val == SWITCHTEC_IMG1_RUNNING)
-			info->active |= SWITCHTEC_FW_PART_RUNNING;
+		pi = &fi->img1;
+		active_reg = &fi->active_img.address;
+		running_reg = &si->img_running;
+		running_val = SWITCHTEC_IMG1_RUNNING;
 		break;
-
 	case SWITCHTEC_FW_TYPE_DAT0:
-		active_addr = gas_read32(dev, &fi->active_cfg.address);
-		set_fw_info_part(dev, info, &fi->cfg0);
-
-		val = gas_read16(dev, &si->cfg_running);
-		if (val == SWITCHTEC_CFG0_RUNNING)
-			info->active |= SWITCHTEC_FW_PART_RUNNING;
+		pi = &fi->cfg0;
+		active_reg = &fi->active_cfg.address;
+		running_reg = &si->cfg_running;
+		running_val = SWITCHTEC_CFG0_RUNNING;
 		break;
-
 	case SWITCHTEC_FW_TYPE_DAT1:
-		active_addr = gas_read32(dev, &fi->active_cfg.address);
-		set_fw_info_part(dev, info, &fi->cfg1);
-
-		val = gas_read16(dev, &si->cfg_running);
-		if (val == SWITCHTEC_CFG1_RUNNING)
-			info->active |= SWITCHTEC_FW_PART_RUNNING;
+		pi = &fi->cfg1;
+		active_reg = &fi->active_cfg.address;
+		running_reg = &si->cfg_running;
+		running_val = SWITCHTEC_CFG1_RUNNING;
 		break;
-
 	case SWITCHTEC_FW_TYPE_NVLOG:
-		set_fw_info_part(dev, info, &fi->nvlog);
+		pi = &fi->nvlog;
 		break;
-
 	default:
 		return -EINVAL;
 	}
 
+	reqs[n++] = (struct gas_read_req)GAS_READ_REQ(&pi->address, &addr);
+	reqs[n++] = (struct gas_read_req)GAS_READ_REQ(&pi->length, &len);
+
+	if (active_reg) {
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(active_reg, &active_addr);
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(running_reg, &val);
+	}
+
+	gas_read_batch(dev, reqs, n);
+
+	info->image_addr = addr;
+	info->image_len = len;
+
+	if (running_reg && val == running_val)
+		info->active |= SWITCHTEC_FW_PART_RUNNING;
+
 	if (info->image_addr == active_addr)
 		info->active |= SWITCHTEC_FW_PART_ACTIVE;
 
 	return 0;
 }
 
+/*
+ * The populated PFFs never change while the device is open, so they are
+ * only probed the first time they're needed. Slots past top.pff_count
+ * or past the first one without the Microsemi vendor ID are not valid.
+ */
+static void gasop_pff_probe(struct switchtec_dev *dev)
+{
+	struct gas_read_req reqs[SWITCHTEC_MAX_PFF_CSR];
+	uint16_t vendor[SWITCHTEC_MAX_PFF_CSR];
+	int i, count;
+
+	if (dev->pff_probed)
+		return;
+
+	count = gas_reg_read8(dev, top.pff_count);
+	if (count > SWITCHTEC_MAX_PFF_CSR)
+		count = SWITCHTEC_MAX_PFF_CSR;
+
+	for (i = 0; i < count; i++)
+		reqs[i] = (struct gas_read_req)
+			GAS_READ_REQ(&dev->gas_map->pff_csr[i].vendor_id,
+				     &vendor[i]);
+
+	gas_read_batch(dev, reqs, count);
+
+	for (i = 0; i < count; i++)
+		if (vendor[i] != MICROSEMI_VENDOR_ID)
+			break;
+
+	dev->pff_count = count;
+	dev->pff_csr_count = i;
+	dev->pff_probed = 1;
+}
+
+/* Number of PFF slots, populated or not */
+static int gasop_pff_count(struct switchtec_dev *dev)
+{
+	gasop_pff_probe(dev);
+	return dev->pff_count;
+}
+
+/* Number of PFF slots up to the first unpopulated one */
+static int gasop_pff_csr_count(struct switchtec_dev *dev)
+{
+	gasop_pff_probe(dev);
+	return dev->pff_csr_count;
+}
+
 int gasop_event_summary(struct switchtec_dev *dev,
 			struct switchtec_event_summary *sum)
 {
-	int i;
-	uint32_t reg;
+	struct gas_read_req reqs[2 + SWITCHTEC_MAX_PARTS +
+				 SWITCHTEC_MAX_PFF_CSR];
+	int i, n = 0;
+	int pff_count = gasop_pff_csr_count(dev);
 
 	memset(sum, 0, sizeof(*sum));
 
-	sum->global = gas_reg_read32(dev, sw_event.global_summary);
-	sum->part_bitmap = gas_reg_read64(dev, sw_event.part_event_bitmap);
+	reqs[n++] = (struct gas_read_req)
+		GAS_READ_REQ(&dev->gas_map->sw_event.global_summary,
+			     &sum->global);
+	reqs[n++] = (struct gas_read_req)
+		GAS_READ_REQ(&dev->gas_map->sw_event.part_event_bitmap,
+			     &sum->part_bitmap);
 
-	for (i = 0; i < dev->partition_count; i++) {
-		reg = gas_reg_read32(dev, part_cfg[i].part_event_summary);
-		sum->part[i] = reg;
-		if (i == dev->partition)
-			sum->local_part = reg;
-	}
+	for (i = 0; i < dev->partition_count && i < SWITCHTEC_MAX_PARTS; i++)
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(&dev->gas_map->part_cfg[i].
+				     part_event_summary, &sum->part[i]);
 
-	for (i = 0; i < SWITCHTEC_MAX_PFF_CSR; i++) {
-		reg = gas_reg_read16(dev, pff_csr[i].vendor_id);
-		if (reg != MICROSEMI_VENDOR_ID)
-			break;
+	for (i = 0; i < pff_count; i++)
+		reqs[n++] = (struct gas_read_req)
+			GAS_READ_REQ(&dev->gas_map->pff_csr[i].
+				     pff_event_summary, &sum->pff[i]);
 
-		sum->pff[i] = gas_reg_read32(dev, pff_csr[i].pff_event_summary);
-	}
+	gas_read_batch(dev, reqs, n);
+
+	if (dev->partition < SWITCHTEC_MAX_PARTS)
+		sum->local_part = sum->part[dev->partition];
 
 	return 0;
 }
@@ -437,7 +1059,7 @@ int gasop_event_ctl(struct switchtec_dev *dev, enum switchtec_event_id e,
 		else if (event_regs[e].map_reg == part_ev_reg)
 			nr_idxs = dev->partition_count;
 		else if (event_regs[e].map_reg == pff_ev_reg)
-			nr_idxs = gas_reg_read8(dev, top.pff_count);
+			nr_idxs = gasop_pff_count(dev);
 		else
 			goto einval;
 
@@ -457,50 +1079,51 @@ einval:
 	return -errno;
 }
 
-int gasop_event_wait_for(struct switchtec_dev *dev,
-			 enum switchtec_event_id e, int index,
+/*
+ * Without an event interrupt the summary has to be polled. Reading it
+ * is cheap on a mapped GAS but can take several milliseconds over I2C
+ * or UART, so measure what a read costs and sleep for whatever is left
+ * of the caller's latency budget between reads.
+ */
+#define GASOP_EVENT_LATENCY_MS	5
+
+int gasop_event_wait_set(struct switchtec_dev *dev,
+			 struct switchtec_event_summary *set,
 			 struct switchtec_event_summary *res,
-			 int timeout_ms)
+			 int latency_ms, int timeout_ms)
 {
-	struct timeval tv;
-	long long start, now;
-	struct switchtec_event_summary wait_for = {0};
+	long long budget_us, cost_us = 0, sleep_us;
+	long long start, deadline = 0, before, now;
 	int ret;
 
-	ret = switchtec_event_summary_set(&wait_for, e, index);
-	if (ret)
-		return ret;
-
-	ret = switchtec_event_ctl(dev, e, index,
-				  SWITCHTEC_EVT_FLAG_CLEAR |
-				  SWITCHTEC_EVT_FLAG_EN_POLL,
-				  NULL);
-	if (ret < 0)
-		return ret;
+	if (latency_ms <= 0)
+		latency_ms = GASOP_EVENT_LATENCY_MS;
+	budget_us = latency_ms * 1000LL;
 
-	ret = gettimeofday(&tv, NULL);
-	if (ret)
-		return ret;
-
-	now = start = ((tv.tv_sec) * 1000 + tv.tv_usec / 1000);
+	start = now_us();
+	if (timeout_ms > 0)
+		deadline = start + timeout_ms * 1000LL;
 
 	while (1) {
-		ret = switchtec_event_check(dev, &wait_for, res);
-		if (ret < 0)
-			return ret;
-
-		if (ret)
-			return 1;
-
-		ret = gettimeofday(&tv, NULL);
+		before = now_us();
+		ret = switchtec_event_check(dev, set, res);
 		if (ret)
 			return ret;
 
-		now = ((tv.tv_sec) * 1000 + tv.tv_usec / 1000);
+		now = now_us();
+		if (cost_us)
+			cost_us = (cost_us * 3 + now - before) / 4;
+		else
+			cost_us = now - before;
 
-		if (timeout_ms > 0 && now - start >= timeout_ms)
+		if (deadline && now >= deadline)
 			return 0;
 
-		usleep(5000);
+		sleep_us = budget_us - cost_us;
+		if (deadline && sleep_us > deadline - now)
+			sleep_us = deadline - now;
+
+		if (sleep_us > 0)
+			usleep(sleep_us);
 	}
 }
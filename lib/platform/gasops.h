@@ -27,11 +27,31 @@
 
 #include "switchtec/switchtec.h"
 
+struct gas_read_req;
+struct switchtec_part_pffs;
+
 int gasop_access_check(struct switchtec_dev *dev);
+void gasop_read_batch(struct switchtec_dev *dev,
+		      const struct gas_read_req *reqs, size_t n,
+		      size_t max_gap, size_t max_xfer);
+int gasop_gas_readahead(struct switchtec_dev *dev, int enable);
+void gasop_rcache_read(struct switchtec_dev *dev, void *dest,
+		       const void __gas *src, size_t n,
+		       void (*raw)(struct switchtec_dev *dev, void *dest,
+				   const void __gas *src, size_t n));
+void gasop_rcache_invalidate(struct switchtec_dev *dev);
 void gasop_set_partition_info(struct switchtec_dev *dev);
 int gasop_cmd(struct switchtec_dev *dev, uint32_t cmd,
 	      const void *payload, size_t payload_len, void *resp,
 	      size_t resp_len);
+int gasop_cmdv(struct switchtec_dev *dev, uint32_t cmd,
+	       const struct switchtec_iovec *payload, int payload_cnt,
+	       const struct switchtec_iovec *resp, int resp_cnt);
+int gasop_cmd_submit(struct switchtec_dev *dev, uint32_t cmd,
+		     const void *payload, size_t payload_len);
+int gasop_cmd_poll(struct switchtec_dev *dev, int timeout_ms);
+int gasop_cmd_complete(struct switchtec_dev *dev, void *resp,
+		       size_t resp_len);
 int gasop_get_device_id(struct switchtec_dev *dev);
 int gasop_get_fw_version(struct switchtec_dev *dev, char *buf,
 			 size_t buflen);
@@ -39,6 +59,8 @@ int gasop_pff_to_port(struct switchtec_dev *dev, int pff,
 		      int *partition, int *port);
 int gasop_port_to_pff(struct switchtec_dev *dev, int partition,
 		      int port, int *pff);
+int gasop_part_pffs(struct switchtec_dev *dev,
+		    struct switchtec_part_pffs *parts, int nr_parts);
 int gasop_flash_part(struct switchtec_dev *dev,
 		     struct switchtec_fw_image_info *info,
 		     enum switchtec_fw_image_type part);
@@ -46,9 +68,9 @@ int gasop_event_summary(struct switchtec_dev *dev,
 			struct switchtec_event_summary *sum);
 int gasop_event_ctl(struct switchtec_dev *dev, enum switchtec_event_id e,
 		    int index, int flags, uint32_t data[5]);
-int gasop_event_wait_for(struct switchtec_dev *dev,
-			 enum switchtec_event_id e, int index,
+int gasop_event_wait_set(struct switchtec_dev *dev,
+			 struct switchtec_event_summary *set,
 			 struct switchtec_event_summary *res,
-			 int timeout_ms);
+			 int latency_ms, int timeout_ms);
 
 #endif
@@ -41,15 +41,79 @@
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
+/*
+ * One I2C transaction can write a maximum of 26 bytes, but it is better to
+ * write the GAS with dword so that a long copy never leaves the firmware
+ * merging a partial dword.
+ */
+#define I2C_MAX_WRITE 24
+/*
+ * One I2C transaction can read a maximum of 27 bytes, but it is better to
+ * read GAS with dword. Longer reads are also split on dword boundaries
+ * so that no register is ever read in two halves.
+ */
+#define I2C_MAX_READ 24
+
+/*
+ * Longer transfers are sent as a train of GAS reads or writes in a single
+ * I2C_RDWR ioctl. A read needs two messages (command and response) so
+ * this is the most that fit in one ioctl.
+ */
+#define I2C_MAX_PIPELINE  (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+/*
+ * Each write in a train is followed by a read of its write status
+ * (command and response), so fewer of them fit.
+ */
+#define I2C_WRITE_MSGS  3
+#define I2C_MAX_WRITE_PIPELINE  (I2C_RDWR_IOCTL_MAX_MSGS / I2C_WRITE_MSGS)
+/* Largest GAS read or write message including its header and PEC */
+#define I2C_XFER_BUF_SIZE  32
+/* Time the switch needs before the status of a write can be read */
+#define I2C_WRITE_STATUS_DELAY_US  2000
+
 struct switchtec_i2c {
 	struct switchtec_dev dev;
 	int fd;
 	int i2c_addr;
 	uint8_t tag;
+	pthread_mutex_t lock;
+
+	/* Everything below is protected by lock */
+	int pipeline;
+	int write_window;
+	long long wr_sent_us;
+
+	uint8_t status_cmd;
+	struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+	uint8_t tx_buf[I2C_MAX_PIPELINE][I2C_XFER_BUF_SIZE];
+	uint8_t rx_buf[I2C_MAX_PIPELINE][I2C_XFER_BUF_SIZE];
+};
+
+struct i2c_gas_write_cmd {
+	uint8_t command_code;
+	uint8_t byte_count;
+	uint8_t tag;
+	uint32_t offset;
+	uint8_t data[];
+} __attribute__((packed));
+
+struct i2c_gas_read_cmd {
+	uint8_t command_code;
+	uint8_t byte_count;
+	uint32_t offset;
+	uint8_t data_length;
+} __attribute__((packed));
+
+struct i2c_gas_read_rsp {
+	uint8_t byte_count;
+	/* tail is one byte status and one byte pec */
+	uint8_t data_and_tail[];
 };
 
 #define CMD_GET_CAP  0xE0
@@ -77,6 +141,14 @@ static uint8_t get_tag(struct switchtec_i2c *idev)
 	return idev->tag;
 }
 
+static long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
 static uint8_t i2c_msg_pec(struct i2c_msg *msg, uint8_t byte_count,
                            uint8_t oldchksum, bool init)
 {
@@ -159,10 +231,13 @@ static void i2c_close(struct switchtec_dev *dev)
 {
 	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
 
+	gasop_gas_readahead(dev, 0);
+
 	if (dev->gas_map)
 		munmap((void __force *)dev->gas_map, dev->gas_map_size);
 
 	close(idev->fd);
+	pthread_mutex_destroy(&idev->lock);
 	free(idev);
 }
 
@@ -251,69 +326,112 @@ i2c_ioctl_fail:
 }
 
 /*
- * One I2C transaction can write a maximum of 26 bytes, but it is better to
- * write the GAS with dword.
+ * Issues nmsgs messages using as few I2C_RDWR ioctls as the adapter
+ * accepts. A transfer (per_xfer messages) is never
+ * split across ioctls. Adapters that can't take that many messages at
+ * once drop back to one transfer per ioctl.
  */
-#define I2C_MAX_WRITE 24
+static int i2c_rdwr(struct switchtec_i2c *idev, struct i2c_msg *msgs,
+		    int nmsgs, int per_xfer)
+{
+	struct i2c_rdwr_ioctl_data rwdata;
+	int i, cnt, ret;
+
+	for (i = 0; i < nmsgs; i += cnt) {
+		cnt = idev->pipeline * per_xfer;
+		if (cnt > nmsgs - i)
+			cnt = nmsgs - i;
+
+		rwdata.msgs = &msgs[i];
+		rwdata.nmsgs = cnt;
+
+		ret = ioctl(idev->fd, I2C_RDWR, &rwdata);
+		if (ret < 0 && cnt > per_xfer &&
+		    (errno == EOPNOTSUPP || errno == EINVAL)) {
+			idev->pipeline = 1;
+			cnt = 0;
+			continue;
+		}
+
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
 /*
- * One I2C transaction can read a maximum of 27 bytes, but it is better to
- * read GAS with dword.
+ * A write in slot i of a train uses messages I2C_WRITE_MSGS * i on: the
+ * GAS write itself followed by a read of the write status.
  */
-#define I2C_MAX_READ 24
+static struct i2c_msg *i2c_write_slot_msgs(struct switchtec_i2c *idev,
+					    int slot)
+{
+	return &idev->msgs[slot * I2C_WRITE_MSGS];
+}
 
-static uint8_t i2c_gas_data_write(struct switchtec_dev *dev, void __gas *dest,
-				  const void *src, size_t n, uint8_t tag)
+static void i2c_gas_data_tag(struct switchtec_i2c *idev, int slot,
+			     uint8_t tag)
 {
-	int ret;
-	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
+	struct i2c_gas_write_cmd *i2c_data = (void *)idev->tx_buf[slot];
+	struct i2c_msg *msg = i2c_write_slot_msgs(idev, slot);
 
-	struct i2c_msg msg;
-	struct i2c_rdwr_ioctl_data wdata = {
-		.msgs = &msg,
-		.nmsgs = 1,
-	};
+	i2c_data->tag = tag;
+	/* PEC is the last byte */
+	msg->buf[msg->len - PEC_BYTE_COUNT] =
+		i2c_msg_pec(msg, msg->len - PEC_BYTE_COUNT, 0, true);
+}
 
-	struct {
-		uint8_t command_code;
-		uint8_t byte_count;
-		uint8_t tag;
-		uint32_t offset;
-		uint8_t data[];
-	} __attribute__((packed)) *i2c_data;
+static void i2c_gas_data_write(struct switchtec_i2c *idev, int slot,
+			       uint32_t gas_addr, const void *src, size_t n)
+{
+	struct i2c_gas_write_cmd *i2c_data = (void *)idev->tx_buf[slot];
+	struct i2c_msg *msgs = i2c_write_slot_msgs(idev, slot);
 
-	uint32_t gas_addr = (uint32_t)(dest - (void __gas *)dev->gas_map);
 	assert(n <= I2C_MAX_WRITE);
 
-	/* PEC is the last byte */
-	i2c_data = malloc(sizeof(*i2c_data) + n + PEC_BYTE_COUNT);
-
 	i2c_data->command_code = CMD_GAS_WRITE;
 	i2c_data->byte_count = (sizeof(i2c_data->tag)
 				+ sizeof(i2c_data->offset)
 			        + n);
-	i2c_data->tag = tag;
-
-	gas_addr = htobe32(gas_addr);
-	i2c_data->offset = gas_addr;
+	i2c_data->offset = htobe32(gas_addr);
 	memcpy(&i2c_data->data, src, n);
-	msg.addr = idev->i2c_addr;
-	msg.flags = 0;
-	msg.len = sizeof(*i2c_data) + n + PEC_BYTE_COUNT;
-	msg.buf = (uint8_t *)i2c_data;
 
-	i2c_data->data[n] = i2c_msg_pec(&msg, msg.len - PEC_BYTE_COUNT, 0,
-					 true);
+	msgs[0].addr = idev->i2c_addr;
+	msgs[0].flags = 0;
+	msgs[0].len = sizeof(*i2c_data) + n + PEC_BYTE_COUNT;
+	msgs[0].buf = (uint8_t *)i2c_data;
 
-	ret = ioctl(idev->fd, I2C_RDWR, &wdata);
-	if (ret < 0)
-		goto i2c_write_fail;
+	idev->status_cmd = CMD_GET_WRITE_STATUS;
 
-	free(i2c_data);
-	return 0;
+	msgs[1].addr = msgs[2].addr = idev->i2c_addr;
+	msgs[1].flags = 0;
+	msgs[1].len = 1;
+	msgs[1].buf = &idev->status_cmd;
 
-i2c_write_fail:
-	free(i2c_data);
-	return -1;
+	msgs[2].flags = I2C_M_RD;
+	msgs[2].len = 3;
+	msgs[2].buf = idev->rx_buf[slot];
+}
+
+/*
+ * Checks the write status read right after the write in a slot. It
+ * only vouches for that write if it carries the write's own tag.
+ */
+static bool i2c_gas_data_write_ok(struct switchtec_i2c *idev, int slot)
+{
+	struct i2c_gas_write_cmd *i2c_data = (void *)idev->tx_buf[slot];
+	struct i2c_msg *msgs = i2c_write_slot_msgs(idev, slot);
+	uint8_t *rx_buf = msgs[2].buf;
+	uint8_t msg_0_pec, pec;
+
+	msg_0_pec = i2c_msg_pec(&msgs[1], msgs[1].len, 0, true);
+	pec = i2c_msg_pec(&msgs[2], msgs[2].len - PEC_BYTE_COUNT,
+			  msg_0_pec, false);
+	if (rx_buf[0] != i2c_data->tag || rx_buf[2] != pec)
+		return false;
+
+	return rx_buf[1] == 0 || rx_buf[1] == GAS_TWI_MRPC_ERR;
 }
 
 static uint8_t i2c_gas_write_status_get(struct switchtec_dev *dev,
@@ -332,6 +450,7 @@ static uint8_t i2c_gas_write_status_get(struct switchtec_dev *dev,
 
 	uint8_t msg_0_pec, pec;
 	uint8_t retry_count = 0;
+	long long delay;
 
 	msgs[0].addr = msgs[1].addr = idev->i2c_addr;
 	msgs[0].flags = 0;
@@ -342,8 +461,14 @@ static uint8_t i2c_gas_write_status_get(struct switchtec_dev *dev,
 	msgs[1].len = 3;
 	msgs[1].buf = rx_buf;
 
+	/* Only wait out whatever is left of the delay since the write */
+	delay = I2C_WRITE_STATUS_DELAY_US - (now_us() - idev->wr_sent_us);
+
 	do {
-		usleep(2000);
+		if (delay > 0)
+			usleep(delay);
+		delay = I2C_WRITE_STATUS_DELAY_US;
+
 		ret = ioctl(idev->fd, I2C_RDWR, &rwdata);
 		if (ret < 0)
 			goto i2c_ioctl_fail;
@@ -367,158 +492,268 @@ i2c_ioctl_fail:
 	return -1;
 }
 
-static void i2c_gas_write(struct switchtec_dev *dev, void __gas *dest,
-			  const void *src, size_t n)
+/*
+ * Sends the write in a slot on its own and waits for its status, with
+ * the same retries a single write has always had.
+ */
+static int i2c_gas_write_one(struct switchtec_i2c *idev, int slot)
 {
-	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
-	uint8_t tag;
-	uint8_t status;
 	uint8_t retry_count = 0;
+	uint8_t status, tag;
 
 	do {
 		tag = get_tag(idev);
-		i2c_gas_data_write(dev, dest, src, n, tag);
-		status = i2c_gas_write_status_get(dev, tag);
-		if (status == 0 || status == GAS_TWI_MRPC_ERR)
-			break;
+		i2c_gas_data_tag(idev, slot, tag);
+		if (!i2c_rdwr(idev, i2c_write_slot_msgs(idev, slot), 1, 1)) {
+			idev->wr_sent_us = now_us();
+			status = i2c_gas_write_status_get(&idev->dev, tag);
+			if (status == 0 || status == GAS_TWI_MRPC_ERR)
+				return 0;
+		}
 		retry_count++;
-	}while (retry_count < MAX_RETRY_COUNT);
+	} while (retry_count < MAX_RETRY_COUNT);
 
-	if (retry_count == MAX_RETRY_COUNT)
-		raise(SIGBUS);
+	return -1;
 }
 
-static void i2c_memcpy_to_gas(struct switchtec_dev *dev, void __gas *dest,
-			      const void *src, size_t n)
+/*
+ * Sends up to write_window tagged GAS writes as one train, each followed
+ * by a read of the write status. The status only ever reports the most
+ * recent write, so each one has to be read in between. The last write
+ * can still be waited for afterwards, but any earlier write whose own
+ * status didn't come back clean is resent and confirmed on its own.
+ * Trains only carry multi-chunk payloads which are safe to write twice;
+ * a single write (like the MRPC command register) is never resent
+ * unless the switch reports it failed.
+ */
+static int i2c_gas_write(struct switchtec_dev *dev, void __gas *dest,
+			 const void *src, size_t n)
 {
-	size_t cnt;
+	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
+	uint32_t gas_addr = (uint32_t)(dest - (void __gas *)dev->gas_map);
+	int chunks = (n + I2C_MAX_WRITE - 1) / I2C_MAX_WRITE;
+	struct i2c_gas_write_cmd *last;
+	bool last_ok;
+	uint8_t status;
+	size_t off, cnt;
+	int i, ret;
 
-	while (n) {
-		cnt = n > I2C_MAX_WRITE ? I2C_MAX_WRITE : n;
-		i2c_gas_write(dev, dest, src, cnt);
+	for (i = 0; i < chunks; i++) {
+		off = i * I2C_MAX_WRITE;
+		cnt = n - off > I2C_MAX_WRITE ? I2C_MAX_WRITE : n - off;
+		i2c_gas_data_write(idev, i, gas_addr + off, src + off, cnt);
+	}
 
-		dest += cnt;
-		src += cnt;
-		n -= cnt;
+	if (chunks == 1)
+		return i2c_gas_write_one(idev, 0);
+
+	for (i = 0; i < chunks; i++)
+		i2c_gas_data_tag(idev, i, get_tag(idev));
+
+	ret = i2c_rdwr(idev, idev->msgs, chunks * I2C_WRITE_MSGS,
+		       I2C_WRITE_MSGS);
+	idev->wr_sent_us = now_us();
+
+	/* Wait for the last write before any resend replaces its status */
+	last_ok = !ret && i2c_gas_data_write_ok(idev, chunks - 1);
+	if (!ret && !last_ok) {
+		last = (void *)idev->tx_buf[chunks - 1];
+		status = i2c_gas_write_status_get(dev, last->tag);
+		last_ok = status == 0 || status == GAS_TWI_MRPC_ERR;
+	}
+
+	for (i = 0; i < chunks; i++) {
+		if (i == chunks - 1 ? last_ok :
+		    !ret && i2c_gas_data_write_ok(idev, i))
+			continue;
+
+		if (i2c_gas_write_one(idev, i))
+			return -1;
 	}
+
+	return 0;
 }
 
-static uint8_t i2c_gas_data_read(struct switchtec_dev *dev, void *dest,
-				 const void __gas *src, size_t n)
+static void i2c_memcpy_to_gas(struct switchtec_dev *dev, void __gas *dest,
+			      const void *src, size_t n)
 {
-	int ret;
-	int pec_index, status_index;
-	uint8_t msg_0_pec, pec;
-	uint8_t retry_count = 0;
-
 	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
-	uint32_t gas_addr = (uint32_t)(src - (void __gas *)dev->gas_map);
-	uint8_t status;
+	size_t cnt, max;
+	int ret = 0;
 
-	struct i2c_msg msgs[2];
-	struct i2c_rdwr_ioctl_data rwdata = {
-		.msgs = msgs,
-		.nmsgs = 2,
-	};
+	/* The tag and its write status must not interleave with other threads */
+	pthread_mutex_lock(&idev->lock);
 
-	struct {
-		uint8_t command_code;
-		uint8_t byte_count;
-		uint32_t offset;
-		uint8_t data_length;
-	} __attribute__((packed)) *read_command;
+	max = idev->write_window * I2C_MAX_WRITE;
 
-	struct {
-		uint8_t byte_count;
-		/* tail is one byte status and one byte pec */
-		uint8_t data_and_tail[];
-	}*read_response;
+	while (n && !ret) {
+		cnt = n > max ? max : n;
+		ret = i2c_gas_write(dev, dest, src, cnt);
 
-	read_command = malloc(sizeof(*read_command));
-	read_response = malloc(sizeof(*read_response) + n \
-			       + DATA_TAIL_BYTE_COUNT);
+		dest += cnt;
+		src += cnt;
+		n -= cnt;
+	}
 
-	msgs[0].addr = msgs[1].addr = idev->i2c_addr;
-	msgs[0].flags = 0;
-	msgs[0].len = sizeof(*read_command);
+	pthread_mutex_unlock(&idev->lock);
+
+	gasop_rcache_invalidate(dev);
+
+	if (ret)
+		raise(SIGBUS);
+}
+
+static void i2c_gas_read_msgs(struct switchtec_i2c *idev,
+			      struct i2c_msg *msgs, int slot,
+			      uint32_t gas_addr, size_t n)
+{
+	struct i2c_gas_read_cmd *read_command = (void *)idev->tx_buf[slot];
+	struct i2c_gas_read_rsp *read_response = (void *)idev->rx_buf[slot];
 
 	read_command->command_code = CMD_GAS_READ;
 	read_command->byte_count = sizeof(read_command->offset) \
 				   + sizeof(read_command->data_length);
-	gas_addr = htobe32(gas_addr);
-	read_command->offset = gas_addr;
+	read_command->offset = htobe32(gas_addr);
 	read_command->data_length = n;
+
+	msgs[0].addr = msgs[1].addr = idev->i2c_addr;
+	msgs[0].flags = 0;
+	msgs[0].len = sizeof(*read_command);
 	msgs[0].buf = (uint8_t *)read_command;
 
 	msgs[1].flags = I2C_M_RD;
 	msgs[1].len = sizeof(read_response->byte_count) + n + \
 		      DATA_TAIL_BYTE_COUNT;
 	msgs[1].buf = (uint8_t *)read_response;
+}
 
-	do {
-		ret = ioctl(idev->fd, I2C_RDWR, &rwdata);
-		if (ret < 0)
-			goto i2c_read_fail;
+/*
+ * Checks the PEC and status of a completed GAS read and copies out the
+ * data. Returns the number of data bytes or -1 if it needs to be resent.
+ */
+static int i2c_gas_read_check(struct i2c_msg *msgs, void *dest)
+{
+	struct i2c_gas_read_rsp *read_response = (void *)msgs[1].buf;
+	int n = msgs[1].len - sizeof(read_response->byte_count) \
+		- DATA_TAIL_BYTE_COUNT;
+	uint8_t msg_0_pec, pec, status;
+
+	msg_0_pec = i2c_msg_pec(&msgs[0], msgs[0].len, 0, true);
+	pec = i2c_msg_pec(&msgs[1], msgs[1].len - PEC_BYTE_COUNT, \
+			   msg_0_pec, false);
+	if (read_response->data_and_tail[n + 1] != pec)
+		return -1;
 
-		msg_0_pec = i2c_msg_pec(&msgs[0], msgs[0].len, 0, true);
-		pec = i2c_msg_pec(&msgs[1], msgs[1].len - PEC_BYTE_COUNT, \
-				   msg_0_pec, false);
-		pec_index = msgs[1].len - sizeof(read_response->byte_count) \
-			    - PEC_BYTE_COUNT;
-		if (read_response->data_and_tail[ pec_index ] == pec)
-			break;
+	status = read_response->data_and_tail[n];
+	if (status != 0 && status != GAS_TWI_MRPC_ERR)
+		return -1;
 
-		retry_count++;
-	} while(retry_count < MAX_RETRY_COUNT);
+	memcpy(dest, read_response->data_and_tail, n);
+	return n;
+}
 
-	if (retry_count == MAX_RETRY_COUNT)
-		goto i2c_read_fail;
+/*
+ * Finds the part of a read handled by chunk i of a train. Chunks after
+ * the first start on a dword boundary even if the read doesn't.
+ */
+static void i2c_gas_read_chunk(struct switchtec_i2c *idev, uint32_t gas_addr,
+			       size_t n, int i, size_t *off, size_t *cnt)
+{
+	size_t start = 0, end;
 
-	memcpy(dest, read_response->data_and_tail, n);
-	status_index = msgs[1].len - sizeof(read_response->byte_count) \
-		       - DATA_TAIL_BYTE_COUNT;
-	status = read_response->data_and_tail[ status_index ];
+	if (i)
+		start = i * I2C_MAX_READ - (gas_addr & 3);
 
-	free(read_command);
-	free(read_response);
-	return status;
+	end = (i + 1) * I2C_MAX_READ - (gas_addr & 3);
+	if (end > n)
+		end = n;
 
-i2c_read_fail:
-	free(read_command);
-	free(read_response);
-	return -1;
+	*off = start;
+	*cnt = end - start;
 }
 
-static void i2c_gas_read(struct switchtec_dev *dev, void *dest,
-			 const void __gas *src, size_t n)
+/*
+ * Reads up to I2C_MAX_PIPELINE * max_read bytes, less the misalignment
+ * of src, as a train of GAS reads. Only the reads that fail their PEC
+ * or status check are resent.
+ */
+static int i2c_gas_read(struct switchtec_dev *dev, void *dest,
+			const void __gas *src, size_t n)
 {
-	uint8_t status;
+	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
+	uint32_t gas_addr = (uint32_t)(src - (void __gas *)dev->gas_map);
+	int chunks = ((gas_addr & 3) + n + I2C_MAX_READ - 1) / I2C_MAX_READ;
+	uint32_t pending = (1U << chunks) - 1;
 	uint8_t retry_count = 0;
+	size_t off, cnt;
+	int i, nmsgs;
+
+	while (pending) {
+		if (retry_count++ == MAX_RETRY_COUNT)
+			return -1;
+
+		nmsgs = 0;
+		for (i = 0; i < chunks; i++) {
+			if (!(pending & (1U << i)))
+				continue;
+
+			i2c_gas_read_chunk(idev, gas_addr, n, i, &off, &cnt);
+			i2c_gas_read_msgs(idev, &idev->msgs[nmsgs], i,
+					  gas_addr + off, cnt);
+			nmsgs += 2;
+		}
+
+		if (i2c_rdwr(idev, idev->msgs, nmsgs, 2))
+			continue;
+
+		nmsgs = 0;
+		for (i = 0; i < chunks; i++) {
+			if (!(pending & (1U << i)))
+				continue;
+
+			i2c_gas_read_chunk(idev, gas_addr, n, i, &off, &cnt);
+			if (i2c_gas_read_check(&idev->msgs[nmsgs],
+					       dest + off) >= 0)
+				pending &= ~(1U << i);
+			nmsgs += 2;
+		}
+	}
 
-	do {
-		status = i2c_gas_data_read(dev, dest, src, n);
-		if (status == 0 || status == GAS_TWI_MRPC_ERR)
-			break;
-		retry_count++;
-	}while(retry_count < MAX_RETRY_COUNT);
-
-	if (retry_count == MAX_RETRY_COUNT)
-		raise(SIGBUS);
+	return 0;
 }
 
-static void i2c_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
-			        const void __gas *src, size_t n)
+static void i2c_memcpy_from_gas_raw(struct switchtec_dev *dev, void *dest,
+				    const void __gas *src, size_t n)
 {
-	size_t cnt;
+	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
+	size_t cnt, max;
+	int ret = 0;
+
+	pthread_mutex_lock(&idev->lock);
 
-	while (n) {
-		cnt = n > I2C_MAX_READ ? I2C_MAX_READ : n;
-		i2c_gas_read(dev, dest, src, cnt);
+	while (n && !ret) {
+		/* Keep the next train starting on a dword boundary */
+		max = I2C_MAX_PIPELINE * I2C_MAX_READ -
+			(((const char __gas *)src -
+			  (const char __gas *)dev->gas_map) & 3);
+		cnt = n > max ? max : n;
+		ret = i2c_gas_read(dev, dest, src, cnt);
 
 		dest += cnt;
 		src += cnt;
 		n -= cnt;
 	}
+
+	pthread_mutex_unlock(&idev->lock);
+
+	if (ret)
+		raise(SIGBUS);
+}
+
+static void i2c_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
+			        const void __gas *src, size_t n)
+{
+	gasop_rcache_read(dev, dest, src, n, i2c_memcpy_from_gas_raw);
 }
 
 static ssize_t i2c_write_from_gas(struct switchtec_dev *dev, int fd,
@@ -555,25 +790,37 @@ create_gas_read(uint64_t, 64);
 static void i2c_gas_write8(struct switchtec_dev *dev, uint8_t val,
 			   uint8_t __gas *addr)
 {
-	i2c_gas_write(dev, addr, &val, sizeof(uint8_t));
+	i2c_memcpy_to_gas(dev, addr, &val, sizeof(uint8_t));
 }
 
 static void i2c_gas_write16(struct switchtec_dev *dev, uint16_t val,
 			    uint16_t __gas *addr)
 {
-	i2c_gas_write(dev, addr, &val, sizeof(uint16_t));
+	i2c_memcpy_to_gas(dev, addr, &val, sizeof(uint16_t));
 }
 
 static void i2c_gas_write32(struct switchtec_dev *dev, uint32_t val,
 			    uint32_t __gas *addr)
 {
-	i2c_gas_write(dev, addr, &val, sizeof(uint32_t));
+	i2c_memcpy_to_gas(dev, addr, &val, sizeof(uint32_t));
 }
 
 static void i2c_gas_write64(struct switchtec_dev *dev, uint64_t val,
 			    uint64_t __gas *addr)
 {
-	i2c_gas_write(dev, addr, &val, sizeof(uint64_t));
+	i2c_memcpy_to_gas(dev, addr, &val, sizeof(uint64_t));
+}
+
+/*
+ * Each I2C transaction costs an address phase and a PEC check, so
+ * reading over a small hole is cheaper than starting another one.
+ */
+#define I2C_BATCH_MAX_GAP 16
+
+static void i2c_gas_read_batch(struct switchtec_dev *dev,
+			       const struct gas_read_req *reqs, size_t n)
+{
+	gasop_read_batch(dev, reqs, n, I2C_BATCH_MAX_GAP, I2C_MAX_READ);
 }
 
 static const struct switchtec_ops i2c_ops = {
@@ -581,14 +828,19 @@ static const struct switchtec_ops i2c_ops = {
 	.gas_map = i2c_gas_map,
 
 	.cmd = gasop_cmd,
+	.cmdv = gasop_cmdv,
+	.cmd_submit = gasop_cmd_submit,
+	.cmd_poll = gasop_cmd_poll,
+	.cmd_complete = gasop_cmd_complete,
 	.get_device_id = gasop_get_device_id,
 	.get_fw_version = gasop_get_fw_version,
 	.pff_to_port = gasop_pff_to_port,
 	.port_to_pff = gasop_port_to_pff,
+	.part_pffs = gasop_part_pffs,
 	.flash_part = gasop_flash_part,
 	.event_summary = gasop_event_summary,
 	.event_ctl = gasop_event_ctl,
-	.event_wait_for = gasop_event_wait_for,
+	.event_wait_set = gasop_event_wait_set,
 
 	.gas_read8 = i2c_gas_read8,
 	.gas_read16 = i2c_gas_read16,
@@ -601,16 +853,22 @@ static const struct switchtec_ops i2c_ops = {
 	.memcpy_to_gas = i2c_memcpy_to_gas,
 	.memcpy_from_gas = i2c_memcpy_from_gas,
 	.write_from_gas = i2c_write_from_gas,
+	.gas_read_batch = i2c_gas_read_batch,
+	.gas_readahead = gasop_gas_readahead,
 };
 
 struct switchtec_dev *switchtec_open_i2c(const char *path, int i2c_addr)
 {
 	struct switchtec_i2c *idev;
 
-	idev = malloc(sizeof(*idev));
+	idev = calloc(1, sizeof(*idev));
 	if (!idev)
 		return NULL;
 
+	pthread_mutex_init(&idev->lock, NULL);
+	idev->pipeline = I2C_MAX_PIPELINE;
+	idev->write_window = 1;
+
 	idev->fd = open(path, O_RDWR | O_CLOEXEC);
 	if (idev->fd < 0)
 		goto err_free;
@@ -631,6 +889,7 @@ struct switchtec_dev *switchtec_open_i2c(const char *path, int i2c_addr)
 		goto err_close_free;
 
 	idev->dev.ops = &i2c_ops;
+	switchtec_cmdq_init(&idev->dev);
 
 	gasop_set_partition_info(&idev->dev);
 
@@ -639,6 +898,7 @@ struct switchtec_dev *switchtec_open_i2c(const char *path, int i2c_addr)
 err_close_free:
 	close(idev->fd);
 err_free:
+	pthread_mutex_destroy(&idev->lock);
 	free(idev);
 	return NULL;
 }
@@ -652,4 +912,68 @@ struct switchtec_dev *switchtec_open_i2c_by_adapter(int adapter, int i2c_addr)
 	return switchtec_open_i2c(path, i2c_addr);
 }
 
+/**
+ * @brief Get the transfer parameters in use on an I2C device
+ * @param[in]  dev	Switchtec device handle opened with switchtec_open_i2c()
+ * @param[out] info	Transfer sizes and pipelining settings
+ * @return 0 on success, negative on failure
+ *
+ * The transfer sizes are fixed, dword aligned limits of the GAS access
+ * protocol. The pipeline depth drops to 1 if the adapter turns out not
+ * to accept several transfers in one ioctl.
+ */
+int switchtec_i2c_get_info(struct switchtec_dev *dev,
+			   struct switchtec_i2c_info *info)
+{
+	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
+
+	if (dev->ops != &i2c_ops) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	pthread_mutex_lock(&idev->lock);
+	info->max_read = I2C_MAX_READ;
+	info->max_write = I2C_MAX_WRITE;
+	info->pipeline = idev->pipeline;
+	info->write_window = idev->write_window;
+	pthread_mutex_unlock(&idev->lock);
+
+	return 0;
+}
+
+/**
+ * @brief Set how many GAS writes are sent in one I2C transfer
+ * @param[in] dev	Switchtec device handle opened with switchtec_open_i2c()
+ * @param[in] window	Number of writes per I2C_RDWR ioctl (1 to 14)
+ * @return 0 on success, negative on failure
+ *
+ * The default of 1 sends each write on its own and waits for its status
+ * like older releases. Larger windows send a train of writes, each
+ * followed by a read of its status, and resend any write the switch
+ * hadn't confirmed by then. This only pays off if the switch keeps up
+ * with the train, so it should be measured on the adapter in use before
+ * it is enabled.
+ */
+int switchtec_i2c_set_write_window(struct switchtec_dev *dev, int window)
+{
+	struct switchtec_i2c *idev = to_switchtec_i2c(dev);
+
+	if (dev->ops != &i2c_ops) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	if (window < 1 || window > I2C_MAX_WRITE_PIPELINE) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	pthread_mutex_lock(&idev->lock);
+	idev->write_window = window;
+	pthread_mutex_unlock(&idev->lock);
+
+	return 0;
+}
+
 #endif
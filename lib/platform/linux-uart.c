@@ -27,6 +27,7 @@
 #include "../switchtec_priv.h"
 #include "../crc8.h"
 #include "switchtec/switchtec.h"
+#include "switchtec/utils.h"
 #include "gasops.h"
 
 #include <sys/types.h>
@@ -40,6 +41,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 #include <stdarg.h>
 
 #include <sys/file.h>
@@ -106,9 +108,17 @@
  * 	     0x00000000:0d93>
  */
 
+/* Holds a full response to the largest read: 3 characters per byte */
+#define UART_RX_BUF_SIZE			8192
+
 struct switchtec_uart{
 	struct switchtec_dev dev;
 	int fd;
+	/* serializes command/response exchanges on the console */
+	pthread_mutex_t lock;
+	/* console output for the current command, protected by lock */
+	char rx_buf[UART_RX_BUF_SIZE];
+	int baud;
 };
 
 #define to_switchtec_uart(d) \
@@ -118,7 +128,52 @@ struct switchtec_uart{
 #define UART_MAX_WRITE_BYTES			100
 #define UART_MAX_READ_BYTES			1024
 #define RETRY_NUM				3
-#define SWITCHTEC_UART_BAUDRATE			(B230400)
+#define SWITCHTEC_UART_BAUDRATE			230400
+/* Read timeouts in tenths of a second */
+#define UART_TIMEOUT				50
+#define UART_PROBE_TIMEOUT			2
+
+static const struct {
+	int baud;
+	speed_t speed;
+} uart_speeds[] = {
+	{9600, B9600},
+	{19200, B19200},
+	{38400, B38400},
+	{57600, B57600},
+	{115200, B115200},
+	{230400, B230400},
+#ifdef B460800
+	{460800, B460800},
+#endif
+#ifdef B500000
+	{500000, B500000},
+#endif
+#ifdef B576000
+	{576000, B576000},
+#endif
+#ifdef B921600
+	{921600, B921600},
+#endif
+#ifdef B1000000
+	{1000000, B1000000},
+#endif
+#ifdef B1152000
+	{1152000, B1152000},
+#endif
+#ifdef B1500000
+	{1500000, B1500000},
+#endif
+#ifdef B2000000
+	{2000000, B2000000},
+#endif
+#ifdef B3000000
+	{3000000, B3000000},
+#endif
+#ifdef B4000000
+	{4000000, B4000000},
+#endif
+};
 
 static int send_cmd(int fd, const char *fmt, int write_bytes, ...)
 {
@@ -163,38 +218,117 @@ static int send_cmd(int fd, const char *fmt, int write_bytes, ...)
 	return 0;
 }
 
-static int read_resp_line(int fd, char *str)
+static int hex_digit(char c)
 {
-	int ret;
-	int cnt = 0;
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static const char *skip_space(const char *p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+	return p;
+}
+
+/* Parses a hex number with an optional 0x prefix, NULL if there's none */
+static const char *parse_hex(const char *p, uint32_t *val)
+{
+	const char *start;
+	uint32_t v = 0;
+
+	p = skip_space(p);
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+		p += 2;
+
+	for (start = p; hex_digit(*p) >= 0; p++)
+		v = (v << 4) | hex_digit(*p);
 
-	while(1) {
-		ret = read(fd, str + cnt, sizeof(str));
-		if (ret <= 0)
+	if (p == start)
+		return NULL;
+
+	*val = v;
+	return p;
+}
+
+static const char *parse_dec(const char *p, uint32_t *val)
+{
+	const char *start;
+	uint32_t v = 0;
+
+	p = skip_space(p);
+	for (start = p; *p >= '0' && *p <= '9'; p++)
+		v = v * 10 + *p - '0';
+
+	if (p == start)
+		return NULL;
+
+	*val = v;
+	return p;
+}
+
+/*
+ * Reads console output until the prompt "0x12345678:1234>" that ends
+ * every response. Output arrives in large reads and only the newly
+ * received bytes are checked for the prompt. Nothing is expected after
+ * the prompt, so the buffer starts over with each command.
+ */
+static int read_resp_line(struct switchtec_uart *udev, const char **resp)
+{
+	char *buf = udev->rx_buf;
+	size_t len = 0, scan = 0;
+	ssize_t ret;
+
+	while (1) {
+		if (len == sizeof(udev->rx_buf) - 1) {
+			errno = EOVERFLOW;
+			return -errno;
+		}
+
+		ret = read(udev->fd, buf + len, sizeof(udev->rx_buf) - 1 - len);
+		if (ret < 0)
 			return ret;
 
-		cnt += ret;
-		str[cnt] = '\0';
+		if (!ret) {
+			errno = ETIMEDOUT;
+			return -errno;
+		}
 
-		/* Prompt "0x12345678:1234>" */
-		if (strrchr(str, ':') + 5 == strrchr(str, '>'))
+		len += ret;
+
+		for (; scan < len; scan++) {
+			if (buf[scan] != '>' || scan < 5 || buf[scan - 5] != ':')
+				continue;
+
+			if (hex_digit(buf[scan - 4]) < 0 ||
+			    hex_digit(buf[scan - 3]) < 0 ||
+			    hex_digit(buf[scan - 2]) < 0 ||
+			    hex_digit(buf[scan - 1]) < 0)
+				continue;
+
+			buf[scan + 1] = '\0';
+			*resp = buf;
 			return 0;
+		}
 	}
-
-	return -1;
 }
 
 static int cli_control(struct switchtec_dev *dev, const char *str)
 {
 	int ret;
-	char rtn[1024];
+	const char *rtn;
 	struct switchtec_uart *udev = to_switchtec_uart(dev);
 
 	ret = send_cmd(udev->fd, str, 0);
 	if (ret)
 		return ret;
 
-	ret =  read_resp_line(udev->fd, rtn);
+	ret =  read_resp_line(udev, &rtn);
 	if (ret)
 		return ret;
 
@@ -212,12 +346,15 @@ static void uart_close(struct switchtec_dev *dev)
 	struct switchtec_uart *udev =  to_switchtec_uart(dev);
 	cli_control(dev, "echo 1\r");
 
+	gasop_gas_readahead(dev, 0);
+
 	if (dev->gas_map)
 		munmap((void __force *)dev->gas_map,
 		      dev->gas_map_size);
 
 	flock(udev->fd, LOCK_UN);
 	close(udev->fd);
+	pthread_mutex_destroy(&udev->lock);
 	free(udev);
 }
 
@@ -247,73 +384,117 @@ static gasptr_t uart_gas_map(struct switchtec_dev *dev, int writeable,
 	return dev->gas_map;
 }
 
+/*
+ * Decodes a gasrd response (see the examples at the top of this file).
+ * Returns 1 if the range is beyond the GAS, 0 on success and -1 if the
+ * response doesn't match the request.
+ */
+static int parse_gas_read(const char *resp, uint32_t addr, uint8_t *dest,
+			  size_t n, uint32_t *crc)
+{
+	const char *p;
+	uint32_t raddr, rnum;
+	int hi, lo;
+	size_t i;
+
+	p = strchr(resp, '<');
+	if (!p)
+		return -1;
+
+	p = parse_hex(p + 1, &raddr);
+	if (!p || *p != '>')
+		return -1;
+
+	p = strchr(p, '[');
+	if (!p)
+		return -1;
+
+	p = parse_dec(p + 1, &rnum);
+	if (!p)
+		return -1;
+
+	p = strchr(p, ']');
+	if (!p || raddr != addr || rnum != n)
+		return -1;
+
+	/* case 2: skip the PFF line ahead of the data */
+	p = skip_space(p + 1);
+	if (*p == '[') {
+		p = strchr(p, '\n');
+		if (!p)
+			return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		p = skip_space(p);
+		hi = hex_digit(p[0]);
+		lo = hi < 0 ? -1 : hex_digit(p[1]);
+		if (lo < 0)
+			goto check_range;
+
+		dest[i] = (hi << 4) | lo;
+		p += 2;
+	}
+
+	p = strchr(p, ':');
+	if (!p || !parse_hex(p + 1, crc))
+		return -1;
+
+	return 0;
+
+check_range:
+	/* case 3 */
+	if (strstr(p, "No access beyond the Total GAS Section"))
+		return 1;
+
+	return -1;
+}
+
 static void uart_gas_read(struct switchtec_dev *dev, void *dest,
 				const void __gas *src, size_t n)
 {
 	int ret;
-	int raddr, rnum, rcrc;
-	int i, j;
-	char *pos;
+	int i;
+	const char *gas_rd_rtn;
 	struct switchtec_uart *udev = to_switchtec_uart(dev);
 	uint32_t addr = (uint32_t)(src - (void __gas *)dev->gas_map);
-	uint8_t *ptr = dest;
+	uint32_t be_addr = htobe32(addr);
+	uint32_t rcrc;
 	uint8_t cal;
-	char gas_rd_rtn[4096];
 
+	pthread_mutex_lock(&udev->lock);
 	for (i = 0; i < RETRY_NUM; i++) {
 		ret =  send_cmd(udev->fd, "gasrd -c -s 0x%x %zu\r", 0, addr, n);
 		if (ret)
 			continue;
 
-		ret = read_resp_line(udev->fd, gas_rd_rtn);
+		ret = read_resp_line(udev, &gas_rd_rtn);
 		if (ret)
 			continue;
 
-		/* case 3 */
-		if (strstr(gas_rd_rtn, "No access beyond the Total GAS Section")){
+		ret = parse_gas_read(gas_rd_rtn, addr, dest, n, &rcrc);
+		if (ret > 0) {
 			memset(dest, 0xff, n);
 			break;
 		}
-		/* case 2 */
-		if (strchr(gas_rd_rtn, ',')) {
-			if (sscanf(gas_rd_rtn,
-				 "%*[^<]<0x%x> [%d Byte]%*[^,],%*[^:]: 0x"
-				 "%x%*[^:]:",
-				  &raddr, &rnum, &rcrc) != 3)
-			continue;
-		} else {
-			/* case 1 */
-			if (sscanf(gas_rd_rtn,
-				 "%*[^<]<0x%x> [%d Byte]%*[^:]: 0x%x%*[^:]:",
-				  &raddr, &rnum, &rcrc) != 3)
-			continue;
-		}
 
-		if ((raddr != addr) || (rnum != n))
+		if (ret)
 			continue;
 
-		pos = strchr(gas_rd_rtn, ']');
-		if (strchr(gas_rd_rtn, ','))
-			pos = strchr(gas_rd_rtn, ',') + strlen("not hit");
-		else
-			pos += 2;
-
-		for (j = 0; j < n; j++)
-			*ptr++ = strtol(pos, &pos, 16);
-
-		addr = htobe32(addr);
-		cal = crc8((uint8_t *)&addr, sizeof(addr), 0, true);
+		cal = crc8((uint8_t *)&be_addr, sizeof(be_addr), 0, true);
 		cal = crc8(dest, n, cal, false);
 		if (cal == rcrc)
 			break;
 	}
 
+	pthread_mutex_unlock(&udev->lock);
+
 	if (i == RETRY_NUM)
 		raise(SIGBUS);
 }
 
-static void uart_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
-				const void __gas *src, size_t n)
+static void uart_memcpy_from_gas_raw(struct switchtec_dev *dev, void *dest,
+				     const void __gas *src, size_t n)
 {
 	ssize_t cnt;
 
@@ -326,12 +507,18 @@ static void uart_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
 	}
 }
 
+static void uart_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
+				const void __gas *src, size_t n)
+{
+	gasop_rcache_read(dev, dest, src, n, uart_memcpy_from_gas_raw);
+}
+
 #define create_gas_read(type, suffix) \
 	static type uart_gas_read ## suffix(struct switchtec_dev *dev, \
 		type __gas *addr) \
 	{ \
 		type ret; \
-		uart_gas_read(dev, &ret, addr, sizeof(ret)); \
+		uart_memcpy_from_gas(dev, &ret, addr, sizeof(ret)); \
 		return ret; \
 	}
 create_gas_read(uint8_t, 8);
@@ -344,46 +531,58 @@ static void uart_gas_write(struct switchtec_dev *dev, void __gas *dest,
 {
 	int ret;
 	int i;
-	char gas_wr_rtn[4096];
+	const char *gas_wr_rtn, *p;
 	uint32_t crc;
 	uint32_t cal, exp;
+	uint8_t rev[UART_MAX_WRITE_BYTES];
 	struct switchtec_uart *udev =  to_switchtec_uart(dev);
 	uint32_t addr = (uint32_t)(dest - (void __gas *)dev->gas_map);
 
+	/* The console checksums the payload last byte first */
+	for (i = 0; i < n; i++)
+		rev[i] = ((const uint8_t *)src)[n - 1 - i];
+
 	addr = htobe32(addr);
 	crc = crc8((uint8_t *)&addr, sizeof(addr), 0, true);
-	for (i = n; i > 0; i--)
-		crc = crc8((uint8_t *)src + i - 1, sizeof(uint8_t), crc, false);
+	crc = crc8(rev, n, crc, false);
 
 	addr = htobe32(addr);
+	pthread_mutex_lock(&udev->lock);
 	for (i = 0; i < RETRY_NUM; i++) {
 		ret =  send_cmd(udev->fd, "gaswr -c -s 0x%x 0x",
 			        n, src, crc, addr);
 		if (ret)
 			continue;
 
-		ret = read_resp_line(udev->fd, gas_wr_rtn);
+		ret = read_resp_line(udev, &gas_wr_rtn);
 		if (ret)
 			continue;
 
 		/* case 4 */
 		if (strstr(gas_wr_rtn, "Error with gas_reg_write()"))
 			break;
-		/* case 2 */
-		if (strchr(gas_wr_rtn, ',')) {
-			if (sscanf(gas_wr_rtn, "%*[^,],%*[^:]: [0x%x/0x%x]%*[^:]:",
-				   &cal, &exp) != 2)
-				continue;
-		} else {
-			/* case 1 and case 3 */
-			if (sscanf(gas_wr_rtn, "%*[^:]: [0x%x/0x%x]%*[^:]:",
-				   &cal, &exp) != 2)
-				continue;
-		}
+
+		/* "CRC: [0x84/0x84]" in all other cases */
+		p = strstr(gas_wr_rtn, "CRC:");
+		if (!p)
+			continue;
+
+		p = strchr(p, '[');
+		if (!p)
+			continue;
+
+		p = parse_hex(p + 1, &cal);
+		if (!p || *p != '/' || !parse_hex(p + 1, &exp))
+			continue;
+
 		if ((exp == cal) && (cal == crc))
 			break;
 	}
 
+	pthread_mutex_unlock(&udev->lock);
+
+	gasop_rcache_invalidate(dev);
+
 	if (i == RETRY_NUM)
 		raise(SIGBUS);
 }
@@ -430,19 +629,36 @@ static ssize_t uart_write_from_gas(struct switchtec_dev *dev, int fd,
 	return ret;
 }
 
+/*
+ * Every UART read is a round trip through the console command
+ * parser, so reading over a moderate hole beats issuing another one.
+ */
+#define UART_BATCH_MAX_GAP 64
+
+static void uart_gas_read_batch(struct switchtec_dev *dev,
+				const struct gas_read_req *reqs, size_t n)
+{
+	gasop_read_batch(dev, reqs, n, UART_BATCH_MAX_GAP, UART_MAX_READ_BYTES);
+}
+
 static const struct switchtec_ops uart_ops = {
 	.close = uart_close,
 	.gas_map = uart_gas_map,
 
 	.cmd = gasop_cmd,
+	.cmdv = gasop_cmdv,
+	.cmd_submit = gasop_cmd_submit,
+	.cmd_poll = gasop_cmd_poll,
+	.cmd_complete = gasop_cmd_complete,
 	.get_device_id = gasop_get_device_id,
 	.get_fw_version = gasop_get_fw_version,
 	.pff_to_port = gasop_pff_to_port,
 	.port_to_pff = gasop_port_to_pff,
+	.part_pffs = gasop_part_pffs,
 	.flash_part = gasop_flash_part,
 	.event_summary = gasop_event_summary,
 	.event_ctl = gasop_event_ctl,
-	.event_wait_for = gasop_event_wait_for,
+	.event_wait_set = gasop_event_wait_set,
 
 	.gas_read8 = uart_gas_read8,
 	.gas_read16 = uart_gas_read16,
@@ -456,20 +672,36 @@ static const struct switchtec_ops uart_ops = {
 	.memcpy_to_gas = uart_memcpy_to_gas,
 	.memcpy_from_gas = uart_memcpy_from_gas,
 	.write_from_gas = uart_write_from_gas,
+	.gas_read_batch = uart_gas_read_batch,
+	.gas_readahead = gasop_gas_readahead,
 };
 
-static int set_uart_attribs(int fd, int speed, int parity)
+static int set_uart_attribs(int fd, int baud, int parity, int timeout)
 {
 	int ret;
+	int i;
+	speed_t speed;
 	struct termios uart_attribs;
 	memset(&uart_attribs, 0, sizeof(uart_attribs));
 
+	for (i = 0; i < ARRAY_SIZE(uart_speeds); i++)
+		if (uart_speeds[i].baud == baud)
+			break;
+
+	if (i == ARRAY_SIZE(uart_speeds)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	speed = uart_speeds[i].speed;
+
 	ret = tcgetattr(fd, &uart_attribs);
 	if (ret)
 		return -1;
 
-	cfsetospeed(&uart_attribs, speed);
-	cfsetispeed(&uart_attribs, speed);
+	if (cfsetospeed(&uart_attribs, speed) ||
+	    cfsetispeed(&uart_attribs, speed))
+		return -1;
 
 	uart_attribs.c_iflag &= ~IGNBRK;
 	uart_attribs.c_iflag &= ~(IXON | IXOFF | IXANY);
@@ -482,24 +714,76 @@ static int set_uart_attribs(int fd, int speed, int parity)
 	uart_attribs.c_cflag &= ~CSTOPB;
 	uart_attribs.c_cflag &= ~CRTSCTS;
 	uart_attribs.c_cc[VMIN] = 0;
-	uart_attribs.c_cc[VTIME] = 50;
+	uart_attribs.c_cc[VTIME] = timeout;
 
 	ret = tcsetattr(fd, TCSANOW, &uart_attribs);
 	if (ret)
 		return -1;
 
+	/* tcsetattr() succeeds if any of the changes took, so check */
+	ret = tcgetattr(fd, &uart_attribs);
+	if (ret)
+		return -1;
+
+	if (cfgetospeed(&uart_attribs) != speed) {
+		errno = EINVAL;
+		return -1;
+	}
+
 	return 0;
 }
 
-struct switchtec_dev *switchtec_open_uart(int fd)
+/*
+ * The console's rate can't be changed from the host side, so
+ * negotiating means finding the fastest rate the tty supports that
+ * the console answers on. A bare return only gets the prompt back;
+ * at the wrong rate the reply is noise or nothing at all.
+ */
+static int uart_probe_baud(struct switchtec_uart *udev)
+{
+	const char *resp;
+	int i;
+
+	for (i = ARRAY_SIZE(uart_speeds) - 1; i >= 0; i--) {
+		if (set_uart_attribs(udev->fd, uart_speeds[i].baud, 0,
+				     UART_PROBE_TIMEOUT))
+			continue;
+
+		tcflush(udev->fd, TCIOFLUSH);
+
+		if (send_cmd(udev->fd, "\r", 0))
+			continue;
+
+		if (!read_resp_line(udev, &resp))
+			return uart_speeds[i].baud;
+	}
+
+	errno = EIO;
+	return -1;
+}
+
+/**
+ * @brief Open a switchtec device behind a UART at a given rate
+ * @param[in] fd	File descriptor of the tty
+ * @param[in] baud	Rate in bits per second, 0 for the default (230400) or
+ *			SWITCHTEC_UART_BAUD_AUTO to use the fastest rate the
+ *			console answers on
+ * @return Switchtec device handle, NULL on failure
+ *
+ * The console's own rate is set on the switch side; the library only
+ * matches it. switchtec_uart_get_baud() reports the rate in use.
+ */
+struct switchtec_dev *switchtec_open_uart_baud(int fd, int baud)
 {
 	int ret;
 	struct switchtec_uart *udev;
 
-	udev = malloc(sizeof(*udev));
+	udev = calloc(1, sizeof(*udev));
 	if (!udev)
 		return NULL;
 
+	pthread_mutex_init(&udev->lock, NULL);
+
 	udev->fd = fd;
 	if (udev->fd < 0)
 		goto err_free;
@@ -508,10 +792,20 @@ struct switchtec_dev *switchtec_open_uart(int fd)
 	if (ret)
 		goto err_close_free;
 
-	ret = set_uart_attribs(udev->fd, SWITCHTEC_UART_BAUDRATE, 0);
+	if (baud == SWITCHTEC_UART_BAUD_AUTO) {
+		baud = uart_probe_baud(udev);
+		if (baud < 0)
+			baud = SWITCHTEC_UART_BAUDRATE;
+	} else if (!baud) {
+		baud = SWITCHTEC_UART_BAUDRATE;
+	}
+
+	ret = set_uart_attribs(udev->fd, baud, 0, UART_TIMEOUT);
 	if (ret)
 		goto err_close_free;
 
+	udev->baud = baud;
+
 	ret = cli_control(&udev->dev, "pscdbg 0 all\r");
 	if (ret)
 		goto err_close_free;
@@ -524,6 +818,7 @@ struct switchtec_dev *switchtec_open_uart(int fd)
 		goto err_close_free;
 
 	udev->dev.ops = &uart_ops;
+	switchtec_cmdq_init(&udev->dev);
 	gasop_set_partition_info(&udev->dev);
 	return &udev->dev;
 
@@ -531,9 +826,54 @@ err_close_free:
 	close(udev->fd);
 
 err_free:
+	pthread_mutex_destroy(&udev->lock);
 	free(udev);
 	return NULL;
 }
 
+struct switchtec_dev *switchtec_open_uart(int fd)
+{
+	return switchtec_open_uart_baud(fd, 0);
+}
+
+/**
+ * @brief Open a switchtec device behind a UART by tty path
+ * @param[in] path	Path to the tty (eg. /dev/ttyUSB0)
+ * @param[in] baud	Rate as for switchtec_open_uart_baud()
+ * @return Switchtec device handle, NULL on failure
+ */
+struct switchtec_dev *switchtec_open_uart_by_path(const char *path,
+						  int baud)
+{
+	int fd;
+
+	fd = open(path, O_RDWR | O_CLOEXEC | O_NOCTTY);
+	if (fd < 0)
+		return NULL;
+
+	if (!isatty(fd)) {
+		close(fd);
+		errno = ENOTTY;
+		return NULL;
+	}
+
+	return switchtec_open_uart_baud(fd, baud);
+}
+
+/**
+ * @brief Get the rate a UART attached device is running at
+ * @param[in] dev	Switchtec device handle
+ * @return Rate in bits per second, negative if \p dev isn't on a UART
+ */
+int switchtec_uart_get_baud(struct switchtec_dev *dev)
+{
+	if (dev->ops != &uart_ops) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	return to_switchtec_uart(dev)->baud;
+}
+
 #endif
 
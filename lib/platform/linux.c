@@ -29,6 +29,7 @@
 #include "../switchtec_priv.h"
 #include "switchtec/switchtec.h"
 #include "switchtec/pci.h"
+#include "switchtec/mrpc.h"
 #include "switchtec/utils.h"
 #include "mmap_gas.h"
 #include "gasops.h"
@@ -56,6 +57,14 @@ static const char *sys_path = "/sys/class/switchtec";
 struct switchtec_linux {
 	struct switchtec_dev dev;
 	int fd;
+
+	/*
+	 * The char device takes the command word and payload in a single
+	 * write() and hands back the return code and response in a single
+	 * read(), so MRPC traffic is staged here. Access is serialized by
+	 * the command queue.
+	 */
+	uint8_t mrpc_buf[sizeof(uint32_t) + MRPC_MAX_DATA_LEN];
 };
 
 #define to_switchtec_linux(d)  \
@@ -296,18 +305,28 @@ static int linux_get_fw_version(struct switchtec_dev *dev, char *buf,
 	return 0;
 }
 
-static int submit_cmd(struct switchtec_linux *ldev, uint32_t cmd,
-		      const void *payload, size_t payload_len)
+static int submit_cmdv(struct switchtec_linux *ldev, uint32_t cmd,
+		       const struct switchtec_iovec *payload, int payload_cnt)
 {
-	int ret;
-	size_t bufsize = payload_len + sizeof(cmd);
-	char buf[bufsize];
+	int i;
+	ssize_t ret;
+	size_t bufsize = sizeof(cmd);
 
 	cmd = htole32(cmd);
-	memcpy(buf, &cmd, sizeof(cmd));
-	memcpy(&buf[sizeof(cmd)], payload, payload_len);
+	memcpy(ldev->mrpc_buf, &cmd, sizeof(cmd));
 
-	ret = write(ldev->fd, buf, bufsize);
+	for (i = 0; i < payload_cnt; i++) {
+		if (bufsize + payload[i].iov_len > sizeof(ldev->mrpc_buf)) {
+			errno = EINVAL;
+			return -errno;
+		}
+
+		memcpy(&ldev->mrpc_buf[bufsize], payload[i].iov_base,
+		       payload[i].iov_len);
+		bufsize += payload[i].iov_len;
+	}
+
+	ret = write(ldev->fd, ldev->mrpc_buf, bufsize);
 
 	if (ret < 0)
 		return ret;
@@ -320,54 +339,137 @@ static int submit_cmd(struct switchtec_linux *ldev, uint32_t cmd,
 	return 0;
 }
 
-static int read_resp(struct switchtec_linux *ldev, void *resp,
-		     size_t resp_len)
+static int read_respv(struct switchtec_linux *ldev,
+		      const struct switchtec_iovec *resp, int resp_cnt)
 {
+	int i;
 	int32_t ret;
-    size_t bufsize = sizeof(uint32_t) + resp_len;
-	char buf[bufsize];
+	ssize_t len;
+	size_t off = sizeof(ret);
+	size_t bufsize = sizeof(ret) + iov_total_len(resp, resp_cnt);
 
-	ret = read(ldev->fd, buf, bufsize);
+	if (bufsize > sizeof(ldev->mrpc_buf)) {
+		errno = EINVAL;
+		return -errno;
+	}
 
-	if (ret < 0)
-		return ret;
+	len = read(ldev->fd, ldev->mrpc_buf, bufsize);
 
-	if (ret != bufsize) {
+	if (len < 0)
+		return len;
+
+	if (len != bufsize) {
 		errno = EIO;
 		return -errno;
 	}
 
-	memcpy(&ret, buf, sizeof(ret));
+	memcpy(&ret, ldev->mrpc_buf, sizeof(ret));
 	if (ret)
 		errno = ret;
 
-	if (!resp)
-		return ret;
-
-	memcpy(resp, &buf[sizeof(ret)], resp_len);
+	for (i = 0; i < resp_cnt; i++) {
+		memcpy(resp[i].iov_base, &ldev->mrpc_buf[off],
+		       resp[i].iov_len);
+		off += resp[i].iov_len;
+	}
 
 	return ret;
 }
 
-static int linux_cmd(struct switchtec_dev *dev,  uint32_t cmd,
-		     const void *payload, size_t payload_len, void *resp,
-		     size_t resp_len)
+static int linux_cmdv_submit(struct switchtec_linux *ldev, uint32_t cmd,
+			     const struct switchtec_iovec *payload,
+			     int payload_cnt)
 {
 	int ret;
-	struct switchtec_linux *ldev = to_switchtec_linux(dev);
 
 retry:
-	ret = submit_cmd(ldev, cmd, payload, payload_len);
+	ret = submit_cmdv(ldev, cmd, payload, payload_cnt);
 	if (errno == EBADE) {
-		read_resp(ldev, NULL, 0);
+		read_respv(ldev, NULL, 0);
 		errno = 0;
 		goto retry;
 	}
 
+	return ret;
+}
+
+static int linux_cmd_submit(struct switchtec_dev *dev, uint32_t cmd,
+			    const void *payload, size_t payload_len)
+{
+	struct switchtec_linux *ldev = to_switchtec_linux(dev);
+	struct switchtec_iovec iov = {
+		.iov_base = (void *)payload,
+		.iov_len = payload_len,
+	};
+
+	return linux_cmdv_submit(ldev, cmd, &iov, 1);
+}
+
+static int linux_cmd_poll(struct switchtec_dev *dev, int timeout_ms)
+{
+	int ret;
+	struct switchtec_linux *ldev = to_switchtec_linux(dev);
+	struct pollfd fds = {
+		.fd = ldev->fd,
+		.events = POLLIN,
+	};
+
+	ret = poll(&fds, 1, timeout_ms);
+	if (ret <= 0)
+		return ret;
+
+	if (fds.revents & POLLERR) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	return !!(fds.revents & POLLIN);
+}
+
+static int linux_cmd_complete(struct switchtec_dev *dev, void *resp,
+			      size_t resp_len)
+{
+	struct switchtec_linux *ldev = to_switchtec_linux(dev);
+	struct switchtec_iovec iov = {
+		.iov_base = resp,
+		.iov_len = resp_len,
+	};
+
+	return read_respv(ldev, &iov, resp ? 1 : 0);
+}
+
+static int linux_cmd_fd(struct switchtec_dev *dev)
+{
+	struct switchtec_linux *ldev = to_switchtec_linux(dev);
+
+	return ldev->fd;
+}
+
+static int linux_cmdv(struct switchtec_dev *dev, uint32_t cmd,
+		      const struct switchtec_iovec *payload, int payload_cnt,
+		      const struct switchtec_iovec *resp, int resp_cnt)
+{
+	int ret;
+	struct switchtec_linux *ldev = to_switchtec_linux(dev);
+
+	ret = linux_cmdv_submit(ldev, cmd, payload, payload_cnt);
 	if (ret < 0)
 		return ret;
 
-	return read_resp(ldev, resp, resp_len);
+	return read_respv(ldev, resp, resp_cnt);
+}
+
+static int linux_cmd(struct switchtec_dev *dev,  uint32_t cmd,
+		     const void *payload, size_t payload_len, void *resp,
+		     size_t resp_len)
+{
+	int ret;
+
+	ret = linux_cmd_submit(dev, cmd, payload, payload_len);
+	if (ret < 0)
+		return ret;
+
+	return linux_cmd_complete(dev, resp, resp_len);
 }
 
 static int get_class_devices(const char *searchpath,
@@ -752,6 +854,8 @@ static gasptr_t linux_gas_map(struct switchtec_dev *dev, int writeable,
 		errno = ENODEV;
 		goto unmap_and_exit;
 	}
+
+	dev->gas_direct = 1;
 	return (gasptr_t __force)map;
 
 unmap_and_exit:
@@ -761,6 +865,7 @@ unmap_and_exit:
 
 static void linux_gas_unmap(struct switchtec_dev *dev, gasptr_t map)
 {
+	dev->gas_direct = 0;
 	munmap((void __force *)map, dev->gas_map_size);
 }
 
@@ -951,11 +1056,23 @@ static int linux_event_wait(struct switchtec_dev *dev, int timeout_ms)
 	return 0;
 }
 
+static int linux_event_fd(struct switchtec_dev *dev)
+{
+	struct switchtec_linux *ldev = to_switchtec_linux(dev);
+
+	return ldev->fd;
+}
+
 static const struct switchtec_ops linux_ops = {
 	.close = linux_close,
 	.get_device_id = linux_get_device_id,
 	.get_fw_version = linux_get_fw_version,
 	.cmd = linux_cmd,
+	.cmdv = linux_cmdv,
+	.cmd_submit = linux_cmd_submit,
+	.cmd_poll = linux_cmd_poll,
+	.cmd_complete = linux_cmd_complete,
+	.cmd_fd = linux_cmd_fd,
 	.get_devices = linux_get_devices,
 	.pff_to_port = linux_pff_to_port,
 	.port_to_pff = linux_port_to_pff,
@@ -965,6 +1082,7 @@ static const struct switchtec_ops linux_ops = {
 	.event_summary = linux_event_summary,
 	.event_ctl = linux_event_ctl,
 	.event_wait = linux_event_wait,
+	.event_fd = linux_event_fd,
 
 	.gas_read8 = mmap_gas_read8,
 	.gas_read16 = mmap_gas_read16,
@@ -993,7 +1111,7 @@ struct switchtec_dev *switchtec_open_by_path(const char *path)
 	else
 		errno = 0;
 
-	ldev = malloc(sizeof(*ldev));
+	ldev = calloc(1, sizeof(*ldev));
 	if (!ldev)
 		return NULL;
 
@@ -1006,6 +1124,7 @@ struct switchtec_dev *switchtec_open_by_path(const char *path)
 		goto err_close_free;
 
 	ldev->dev.ops = &linux_ops;
+	switchtec_cmdq_init(&ldev->dev);
 
 	return &ldev->dev;
 
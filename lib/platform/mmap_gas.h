@@ -35,6 +35,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifdef __CHECKER__
 #define __force __attribute__((force))
 #else
@@ -43,16 +47,154 @@
 
 #include "../switchtec_priv.h"
 
+/*
+ * Drain any write-combining buffers so that everything stored before
+ * this point reaches the device ahead of later stores (ie. the MRPC
+ * command doorbell).
+ */
+static inline void mmio_wc_flush(void)
+{
+#ifdef __SSE2__
+	_mm_sfence();
+#else
+	__sync_synchronize();
+#endif
+}
+
+/*
+ * Copy into the BAR with naturally aligned stores. On the
+ * write-combining MRPC window, full 64-byte lines written with 128-bit
+ * stores are merged into a single posted write each.
+ */
+static void mmio_copy_to(volatile void *dest, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uintptr_t d = (uintptr_t)dest;
+	uint64_t v64;
+	uint32_t v32;
+	uint16_t v16;
+
+	while (n && (d & 7)) {
+		if ((d & 1) || n < 2) {
+			*(volatile uint8_t *)d = *s;
+			s += 1; d += 1; n -= 1;
+		} else if ((d & 2) || n < 4) {
+			memcpy(&v16, s, 2);
+			*(volatile uint16_t *)d = v16;
+			s += 2; d += 2; n -= 2;
+		} else {
+			memcpy(&v32, s, 4);
+			*(volatile uint32_t *)d = v32;
+			s += 4; d += 4; n -= 4;
+		}
+	}
+
+#ifdef __SSE2__
+	if ((d & 8) && n >= 72) {
+		memcpy(&v64, s, 8);
+		*(volatile uint64_t *)d = v64;
+		s += 8; d += 8; n -= 8;
+	}
+
+	while (!(d & 15) && n >= 64) {
+		__m128i *p = (__m128i *)d;
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i b = _mm_loadu_si128((const __m128i *)s + 1);
+		__m128i c = _mm_loadu_si128((const __m128i *)s + 2);
+		__m128i e = _mm_loadu_si128((const __m128i *)s + 3);
+
+		_mm_store_si128(p, a);
+		_mm_store_si128(p + 1, b);
+		_mm_store_si128(p + 2, c);
+		_mm_store_si128(p + 3, e);
+		asm volatile("": : :"memory");
+		s += 64; d += 64; n -= 64;
+	}
+#endif
+
+	while (n >= 8) {
+		memcpy(&v64, s, 8);
+		*(volatile uint64_t *)d = v64;
+		s += 8; d += 8; n -= 8;
+	}
+
+	if (n >= 4) {
+		memcpy(&v32, s, 4);
+		*(volatile uint32_t *)d = v32;
+		s += 4; d += 4; n -= 4;
+	}
+
+	if (n >= 2) {
+		memcpy(&v16, s, 2);
+		*(volatile uint16_t *)d = v16;
+		s += 2; d += 2; n -= 2;
+	}
+
+	if (n)
+		*(volatile uint8_t *)d = *s;
+}
+
 static void mmap_memcpy_to_gas(struct switchtec_dev *dev, void __gas *dest,
 			       const void *src, size_t n)
 {
-	memcpy((void __force *)dest, src, n);
+	mmio_copy_to((void __force *)dest, src, n);
+	mmio_wc_flush();
+}
+
+/*
+ * Copy out of the BAR using naturally aligned accesses no wider than
+ * 64 bits. A plain memcpy() is free to issue byte and unaligned loads
+ * which each become a separate non-posted read on the bus.
+ */
+static void mmio_copy_from(void *dest, const volatile void *src, size_t n)
+{
+	uint8_t *d = dest;
+	uintptr_t s = (uintptr_t)src;
+	uint64_t v64;
+	uint32_t v32;
+	uint16_t v16;
+
+	while (n && (s & 7)) {
+		if ((s & 1) || n < 2) {
+			*d = *(const volatile uint8_t *)s;
+			s += 1; d += 1; n -= 1;
+		} else if ((s & 2) || n < 4) {
+			v16 = *(const volatile uint16_t *)s;
+			memcpy(d, &v16, 2);
+			s += 2; d += 2; n -= 2;
+		} else {
+			v32 = *(const volatile uint32_t *)s;
+			memcpy(d, &v32, 4);
+			s += 4; d += 4; n -= 4;
+		}
+	}
+
+	while (n >= 8) {
+		v64 = *(const volatile uint64_t *)s;
+		memcpy(d, &v64, 8);
+		s += 8; d += 8; n -= 8;
+	}
+
+	if (n >= 4) {
+		v32 = *(const volatile uint32_t *)s;
+		memcpy(d, &v32, 4);
+		s += 4; d += 4; n -= 4;
+	}
+
+	if (n >= 2) {
+		v16 = *(const volatile uint16_t *)s;
+		memcpy(d, &v16, 2);
+		s += 2; d += 2; n -= 2;
+	}
+
+	if (n)
+		*d = *(const volatile uint8_t *)s;
 }
 
 static void mmap_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
 				 const void __gas *src, size_t n)
 {
-	memcpy(dest, (void __force *)src, n);
+	mmio_copy_from(dest, (const void __force *)src, n);
 }
 
 static ssize_t mmap_write_from_gas(struct switchtec_dev *dev, int fd,
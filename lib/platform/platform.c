@@ -27,9 +27,13 @@
  * @brief Switchtec platform specific functions
  */
 
+/* The out-of-line GAS accessors are defined here */
+#define SWITCHTEC_GAS_NO_INLINE
+
 #include "../switchtec_priv.h"
 #include "switchtec/switchtec.h"
 #include "switchtec/gas.h"
+#include "gas_direct.h"
 
 #include <errno.h>
 
@@ -91,6 +95,9 @@ void switchtec_close(struct switchtec_dev *dev)
 	if (!dev)
 		return;
 
+	switchtec_cache_disable(dev);
+	switchtec_pff_map_free(dev);
+	switchtec_cmdq_destroy(dev);
 	dev->ops->close(dev);
 }
 
@@ -113,6 +120,9 @@ int switchtec_list(struct switchtec_device_info **devlist);
 int switchtec_get_fw_version(struct switchtec_dev *dev, char *buf,
 			     size_t buflen)
 {
+	if (dev->cache)
+		return switchtec_cache_get_fw_version(dev, buf, buflen);
+
 	return dev->ops->get_fw_version(dev, buf, buflen);
 }
 
@@ -126,15 +136,196 @@ int switchtec_get_fw_version(struct switchtec_dev *dev, char *buf,
  * @param[out] resp		Output data
  * @param[in]  resp_len		Output data length (in bytes)
  * @return 0 on success, negative on failure
+ *
+ * This may be called concurrently from multiple threads on the same
+ * handle. Commands are queued and issued one after another; each caller
+ * gets its own command's return value and errno.
  */
 int switchtec_cmd(struct switchtec_dev *dev,  uint32_t cmd,
 		  const void *payload, size_t payload_len, void *resp,
 		  size_t resp_len)
 {
+	struct switchtec_iovec piov = {
+		.iov_base = (void *)payload,
+		.iov_len = payload_len,
+	};
+	struct switchtec_iovec riov = {
+		.iov_base = resp,
+		.iov_len = resp_len,
+	};
+
+	return switchtec_cmdv(dev, cmd, &piov, 1, &riov, resp ? 1 : 0);
+}
+
+/**
+ * @brief Execute an MRPC command with scatter/gather buffers
+ * @ingroup Device
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  cmd		Command ID
+ * @param[in]  payload		Input data segments, sent back-to-back
+ * @param[in]  payload_cnt	Number of input segments
+ * @param[in]  resp		Output data segments, filled in order
+ * @param[in]  resp_cnt		Number of output segments
+ * @return 0 on success, negative on failure
+ *
+ * This behaves exactly like switchtec_cmd() but lets a caller pass, for
+ * example, a command header and a separate data block without first
+ * copying them into one buffer. The total length of each side must not
+ * exceed MRPC_MAX_DATA_LEN.
+ */
+int switchtec_cmdv(struct switchtec_dev *dev, uint32_t cmd,
+		   const struct switchtec_iovec *payload, int payload_cnt,
+		   const struct switchtec_iovec *resp, int resp_cnt)
+{
+	unsigned gen;
+	int ret;
+
+	cmd &= SWITCHTEC_CMD_MASK;
+	cmd |= dev->pax_id << SWITCHTEC_PAX_ID_SHIFT;
+
+	if (!dev->cache)
+		return switchtec_cmdq_exec(dev, cmd, payload, payload_cnt,
+					   resp, resp_cnt);
+
+	if (switchtec_cache_mrpc_lookup(dev, cmd, payload, payload_cnt,
+					resp, resp_cnt, &gen))
+		return 0;
+
+	ret = switchtec_cmdq_exec(dev, cmd, payload, payload_cnt,
+				  resp, resp_cnt);
+
+	switchtec_cache_mrpc_store(dev, cmd, payload, payload_cnt,
+				   resp, resp_cnt, ret, gen);
+
+	return ret;
+}
+
+/**
+ * @brief Submit an MRPC command without waiting for it to complete
+ * @ingroup Device
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  cmd		Command ID
+ * @param[in]  payload		Input data
+ * @param[in]  payload_len	Input data length (in bytes)
+ * @return 0 on success, negative on failure
+ *
+ * Only one command may be outstanding per handle. The submitting thread
+ * owns the MRPC until it calls switchtec_cmd_complete() and commands
+ * issued from other threads wait until then; the owning thread itself
+ * gets EBUSY if it tries to issue another. Not all platforms support
+ * this, in which case errno will be set to ENOTSUP.
+ */
+int switchtec_cmd_submit(struct switchtec_dev *dev, uint32_t cmd,
+			 const void *payload, size_t payload_len)
+{
+	struct switchtec_iovec piov = {
+		.iov_base = (void *)payload,
+		.iov_len = payload_len,
+	};
+	int ret;
+
+	if (!dev->ops->cmd_submit) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	ret = switchtec_cmdq_acquire(dev);
+	if (ret)
+		return ret;
+
 	cmd &= SWITCHTEC_CMD_MASK;
 	cmd |= dev->pax_id << SWITCHTEC_PAX_ID_SHIFT;
 
-	return dev->ops->cmd(dev, cmd, payload, payload_len, resp, resp_len);
+	dev->stats_async.cmd = cmd;
+	dev->stats_async.subcmd = switchtec_stats_subcmd(cmd, &piov, 1);
+	dev->stats_async.payload_len = payload_len;
+	dev->stats_async.start_ns = switchtec_stats_now();
+
+	ret = dev->ops->cmd_submit(dev, cmd, payload, payload_len);
+	if (ret < 0)
+		switchtec_cmdq_release(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Check whether a submitted MRPC command has completed
+ * @ingroup Device
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  timeout_ms	Time to wait for the completion, 0 to return
+ *				immediately or negative to wait forever
+ * @return 1 if the command completed, 0 if it's still in progress or
+ *	negative on failure
+ */
+int switchtec_cmd_poll(struct switchtec_dev *dev, int timeout_ms)
+{
+	if (!switchtec_cmdq_owned(dev)) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	return dev->ops->cmd_poll(dev, timeout_ms);
+}
+
+/**
+ * @brief Retrieve the result of a submitted MRPC command
+ * @ingroup Device
+ * @param[in]  dev		Switchtec device handle
+ * @param[out] resp		Output data
+ * @param[in]  resp_len		Output data length (in bytes)
+ * @return 0 on success, negative on failure
+ *
+ * This blocks until the command completes if it has not already done so.
+ * The return value has the same meaning as that of switchtec_cmd().
+ */
+int switchtec_cmd_complete(struct switchtec_dev *dev, void *resp,
+			   size_t resp_len)
+{
+	int ret;
+
+	if (!switchtec_cmdq_owned(dev)) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	ret = dev->ops->cmd_complete(dev, resp, resp_len);
+
+	if (dev->cache)
+		switchtec_cache_mrpc_done(dev, dev->stats_async.cmd,
+					  dev->stats_async.subcmd);
+
+	switchtec_stats_record(dev, dev->stats_async.cmd,
+			       dev->stats_async.subcmd,
+			       dev->stats_async.payload_len, resp_len, ret,
+			       switchtec_stats_now() -
+			       dev->stats_async.start_ns);
+
+	switchtec_cmdq_release(dev);
+
+	return ret;
+}
+
+/**
+ * @brief Get a file descriptor that signals MRPC command completion
+ * @ingroup Device
+ * @param[in]  dev		Switchtec device handle
+ * @return A file descriptor or negative on failure
+ *
+ * The returned descriptor becomes readable (POLLIN) when a command
+ * submitted with switchtec_cmd_submit() completes and may be added to
+ * poll() or epoll sets. The descriptor is owned by the handle and must
+ * not be read from or closed. Platforms that poll the MRPC registers
+ * (I2C and UART) have no such descriptor and return -ENOTSUP; they
+ * must use switchtec_cmd_poll() instead.
+ */
+int switchtec_cmd_fd(struct switchtec_dev *dev)
+{
+	if (!dev->ops->cmd_fd) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	return dev->ops->cmd_fd(dev);
 }
 
 /**
@@ -171,7 +362,7 @@ int switchtec_get_devices(struct switchtec_dev *dev,
 int switchtec_pff_to_port(struct switchtec_dev *dev, int pff,
 			  int *partition, int *port)
 {
-	return dev->ops->pff_to_port(dev, pff, partition, port);
+	return switchtec_pff_map_to_port(dev, pff, partition, port);
 }
 
 /**
@@ -186,7 +377,7 @@ int switchtec_pff_to_port(struct switchtec_dev *dev, int pff,
 int switchtec_port_to_pff(struct switchtec_dev *dev, int partition,
 			  int port, int *pff)
 {
-	return dev->ops->port_to_pff(dev, partition, port, pff);
+	return switchtec_pff_map_to_pff(dev, partition, port, pff);
 }
 
 /**
@@ -230,6 +421,30 @@ void switchtec_gas_unmap(struct switchtec_dev *dev, gasptr_t map)
 	dev->ops->gas_unmap(dev, map);
 }
 
+/**
+ * @brief Enable or disable read-ahead caching of GAS reads
+ * @param[in] dev	Switchtec device handle
+ * @param[in] enable	Non-zero to enable the cache, zero to disable it
+ * @return 0 on success, negative on failure
+ *
+ * On platforms where every GAS access is a bus transaction (I2C and
+ * UART), small reads are served from aligned blocks fetched on a miss.
+ * The MRPC, NTB and event registers are never cached, any GAS write
+ * drops everything cached, and blocks expire after a short time so
+ * slowly changing state (such as link status) is never far behind.
+ *
+ * Returns -ENOTSUP on platforms that have no use for the cache.
+ */
+int switchtec_gas_readahead(struct switchtec_dev *dev, int enable)
+{
+	if (!dev->ops->gas_readahead) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	return dev->ops->gas_readahead(dev, enable);
+}
+
 /**
  * @brief Retrieve information about a flash partition
  * @ingroup Firmware
@@ -242,6 +457,9 @@ int switchtec_flash_part(struct switchtec_dev *dev,
 			 struct switchtec_fw_image_info *info,
 			 enum switchtec_fw_image_type part)
 {
+	if (dev->cache)
+		return switchtec_cache_flash_part(dev, info, part);
+
 	return dev->ops->flash_part(dev, info, part);
 }
 
@@ -255,7 +473,13 @@ int switchtec_flash_part(struct switchtec_dev *dev,
 int switchtec_event_summary(struct switchtec_dev *dev,
 			    struct switchtec_event_summary *sum)
 {
-	return dev->ops->event_summary(dev, sum);
+	int ret;
+
+	ret = dev->ops->event_summary(dev, sum);
+	if (!ret && dev->cache)
+		switchtec_cache_events(dev, sum);
+
+	return ret;
 }
 
 /**
@@ -302,6 +526,9 @@ int switchtec_event_wait(struct switchtec_dev *dev, int timeout_ms)
  */
 uint8_t gas_read8(struct switchtec_dev *dev, uint8_t __gas *addr)
 {
+	if (dev->gas_direct)
+		return gas_read8_direct(addr);
+
 	return dev->ops->gas_read8(dev, addr);
 }
 
@@ -313,6 +540,9 @@ uint8_t gas_read8(struct switchtec_dev *dev, uint8_t __gas *addr)
  */
 uint16_t gas_read16(struct switchtec_dev *dev, uint16_t __gas *addr)
 {
+	if (dev->gas_direct)
+		return gas_read16_direct(addr);
+
 	return dev->ops->gas_read16(dev, addr);
 }
 
@@ -324,6 +554,9 @@ uint16_t gas_read16(struct switchtec_dev *dev, uint16_t __gas *addr)
  */
 uint32_t gas_read32(struct switchtec_dev *dev, uint32_t __gas *addr)
 {
+	if (dev->gas_direct)
+		return gas_read32_direct(addr);
+
 	return dev->ops->gas_read32(dev, addr);
 }
 
@@ -335,6 +568,9 @@ uint32_t gas_read32(struct switchtec_dev *dev, uint32_t __gas *addr)
  */
 uint64_t gas_read64(struct switchtec_dev *dev, uint64_t __gas *addr)
 {
+	if (dev->gas_direct)
+		return gas_read64_direct(addr);
+
 	return dev->ops->gas_read64(dev, addr);
 }
 
@@ -346,7 +582,10 @@ uint64_t gas_read64(struct switchtec_dev *dev, uint64_t __gas *addr)
  */
 void gas_write8(struct switchtec_dev *dev, uint8_t val, uint8_t __gas *addr)
 {
-	dev->ops->gas_write8(dev, val, addr);
+	if (dev->gas_direct)
+		gas_write8_direct(val, addr);
+	else
+		dev->ops->gas_write8(dev, val, addr);
 }
 
 /**
@@ -357,7 +596,10 @@ void gas_write8(struct switchtec_dev *dev, uint8_t val, uint8_t __gas *addr)
  */
 void gas_write16(struct switchtec_dev *dev, uint16_t val, uint16_t __gas *addr)
 {
-	dev->ops->gas_write16(dev, val, addr);
+	if (dev->gas_direct)
+		gas_write16_direct(val, addr);
+	else
+		dev->ops->gas_write16(dev, val, addr);
 }
 
 /**
@@ -368,7 +610,10 @@ void gas_write16(struct switchtec_dev *dev, uint16_t val, uint16_t __gas *addr)
  */
 void gas_write32(struct switchtec_dev *dev, uint32_t val, uint32_t __gas *addr)
 {
-	dev->ops->gas_write32(dev, val, addr);
+	if (dev->gas_direct)
+		gas_write32_direct(val, addr);
+	else
+		dev->ops->gas_write32(dev, val, addr);
 }
 
 /**
@@ -379,7 +624,10 @@ void gas_write32(struct switchtec_dev *dev, uint32_t val, uint32_t __gas *addr)
  */
 void gas_write64(struct switchtec_dev *dev, uint64_t val, uint64_t __gas *addr)
 {
-	dev->ops->gas_write64(dev, val, addr);
+	if (dev->gas_direct)
+		gas_write64_direct(val, addr);
+	else
+		dev->ops->gas_write64(dev, val, addr);
 }
 
 /**
@@ -420,3 +668,51 @@ ssize_t write_from_gas(struct switchtec_dev *dev, int fd,
 {
 	return dev->ops->write_from_gas(dev, fd, src, n);
 }
+
+/**
+ * @brief Perform a number of reads from the GAS
+ * @param[in]  dev	Switchtec device handle
+ * @param[in]  reqs	Reads to perform
+ * @param[in]  n	Number of entries in \p reqs
+ *
+ * Reads of 1, 2, 4 or 8 bytes return the same data as the matching
+ * gas_read function and anything else the same as memcpy_from_gas().
+ * Platforms where every access is a bus transaction (I2C and UART) merge
+ * reads of neighbouring registers into fewer, larger transfers, so
+ * gathering a set of registers this way can be much cheaper than reading
+ * them one at a time. The order the reads are issued in is unspecified.
+ */
+void gas_read_batch(struct switchtec_dev *dev,
+		    const struct gas_read_req *reqs, size_t n)
+{
+	const struct gas_read_req *r;
+
+	if (dev->ops->gas_read_batch) {
+		dev->ops->gas_read_batch(dev, reqs, n);
+		return;
+	}
+
+	for (r = reqs; r < reqs + n; r++) {
+		switch (r->len) {
+		case 1:
+			*(uint8_t *)r->dest =
+				gas_read8(dev, (uint8_t __gas *)r->addr);
+			break;
+		case 2:
+			*(uint16_t *)r->dest =
+				gas_read16(dev, (uint16_t __gas *)r->addr);
+			break;
+		case 4:
+			*(uint32_t *)r->dest =
+				gas_read32(dev, (uint32_t __gas *)r->addr);
+			break;
+		case 8:
+			*(uint64_t *)r->dest =
+				gas_read64(dev, (uint64_t __gas *)r->addr);
+			break;
+		default:
+			memcpy_from_gas(dev, r->dest, r->addr, r->len);
+			break;
+		}
+	}
+}
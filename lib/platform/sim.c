@@ -0,0 +1,1272 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Simulated Switchtec device for development and benchmarking
+ */
+
+#include "../switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/errors.h"
+#include "switchtec/log.h"
+#include "switchtec/pmon.h"
+#include "switchtec/endian.h"
+#include "switchtec/utils.h"
+#include "gasops.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#define SIM_DEVICE_ID		0x8536
+#define SIM_FW_VERSION		0x01090157
+#define SIM_DIE_TEMP		4525
+#define SIM_DEFAULT_LATENCY_US	50
+#define SIM_NR_CMDS		128
+
+#define SIM_FLASH_BASE		SWITCHTEC_FLASH_BOOT_PART_START
+#define SIM_FLASH_SIZE		0x800000
+#define SIM_IMG0_ADDR		(SIM_FLASH_BASE + 0x100000)
+#define SIM_IMG1_ADDR		(SIM_FLASH_BASE + 0x280000)
+#define SIM_IMG_LEN		0x180000
+#define SIM_CFG0_ADDR		(SIM_FLASH_BASE + 0x400000)
+#define SIM_CFG1_ADDR		(SIM_FLASH_BASE + 0x440000)
+#define SIM_CFG_LEN		0x40000
+#define SIM_NVLOG_ADDR		(SIM_FLASH_BASE + 0x480000)
+#define SIM_NVLOG_LEN		0x80000
+
+#define SIM_LOG_A_RAM_ENTRIES	1000
+#define SIM_LOG_A_FLASH_ENTRIES	200
+
+struct sim_fw_image_header {
+	char magic[4];
+	uint32_t image_len;
+	uint32_t type;
+	uint32_t load_addr;
+	uint32_t version;
+	uint32_t rsvd[9];
+	uint32_t header_crc;
+	uint32_t image_crc;
+};
+
+struct sim_evcntr {
+	uint32_t mask;
+	uint8_t ieg;
+	uint32_t thresh;
+	long long base_us;
+};
+
+struct switchtec_sim {
+	struct switchtec_dev dev;
+	struct switchtec_gas *gas;
+	int nr_ports;
+
+	/* protects the event registers, which any thread may touch */
+	pthread_mutex_t lock;
+
+	unsigned latency_us[SIM_NR_CMDS];
+	long long mrpc_done_us;
+
+	uint8_t *flash;
+	enum switchtec_fw_dlstatus dlstatus;
+	struct sim_fw_image_header dl_hdr;
+	uint32_t dl_addr;
+	uint8_t boot_ro;
+
+	struct sim_evcntr evcntr[SWITCHTEC_MAX_STACKS]
+				[SWITCHTEC_MAX_EVENT_COUNTERS];
+	long long bw_base_us[SWITCHTEC_MAX_PORTS];
+	uint16_t lat_max_ns[SWITCHTEC_MAX_PORTS];
+};
+
+#define to_switchtec_sim(d)  \
+	((struct switchtec_sim *) \
+	 ((char *)d - offsetof(struct switchtec_sim, dev)))
+
+static const struct switchtec_ops sim_ops;
+
+#ifdef __CHECKER__
+#define __force __attribute__((force))
+#else
+#define __force
+#endif
+
+static long long now_us(void)
+{
+	return switchtec_stats_now() / 1000;
+}
+
+/*
+ * Event header offsets and their summary bits, matching the bit
+ * assignments the core library expects in events.c
+ */
+static const struct sim_event {
+	enum switchtec_event_type type;
+	size_t offset;
+	int bit;
+} sim_events[] = {
+#define SIM_EV(i, t, s, r, b)[SWITCHTEC_ ## i] = \
+	{SWITCHTEC_EVT_ ## t, offsetof(struct s, r), b}
+	SIM_EV(GLOBAL_EVT_STACK_ERROR, GLOBAL, sw_event_regs,
+	       stack_error_event_hdr, 0),
+	SIM_EV(GLOBAL_EVT_PPU_ERROR, GLOBAL, sw_event_regs,
+	       ppu_error_event_hdr, 1),
+	SIM_EV(GLOBAL_EVT_ISP_ERROR, GLOBAL, sw_event_regs,
+	       isp_error_event_hdr, 2),
+	SIM_EV(GLOBAL_EVT_SYS_RESET, GLOBAL, sw_event_regs,
+	       sys_reset_event_hdr, 3),
+	SIM_EV(GLOBAL_EVT_FW_EXC, GLOBAL, sw_event_regs, fw_exception_hdr, 4),
+	SIM_EV(GLOBAL_EVT_FW_NMI, GLOBAL, sw_event_regs, fw_nmi_hdr, 5),
+	SIM_EV(GLOBAL_EVT_FW_NON_FATAL, GLOBAL, sw_event_regs,
+	       fw_non_fatal_hdr, 6),
+	SIM_EV(GLOBAL_EVT_FW_FATAL, GLOBAL, sw_event_regs, fw_fatal_hdr, 7),
+	SIM_EV(GLOBAL_EVT_TWI_MRPC_COMP, GLOBAL, sw_event_regs,
+	       twi_mrpc_comp_hdr, 8),
+	SIM_EV(GLOBAL_EVT_TWI_MRPC_COMP_ASYNC, GLOBAL, sw_event_regs,
+	       twi_mrpc_comp_async_hdr, 9),
+	SIM_EV(GLOBAL_EVT_CLI_MRPC_COMP, GLOBAL, sw_event_regs,
+	       cli_mrpc_comp_hdr, 10),
+	SIM_EV(GLOBAL_EVT_CLI_MRPC_COMP_ASYNC, GLOBAL, sw_event_regs,
+	       cli_mrpc_comp_async_hdr, 11),
+	SIM_EV(GLOBAL_EVT_GPIO_INT, GLOBAL, sw_event_regs,
+	       gpio_interrupt_hdr, 12),
+	SIM_EV(GLOBAL_EVT_GFMS, GLOBAL, sw_event_regs, gfms_event_hdr, 13),
+	SIM_EV(PART_EVT_PART_RESET, PART, part_cfg_regs, part_reset_hdr, 0),
+	SIM_EV(PART_EVT_MRPC_COMP, PART, part_cfg_regs, mrpc_comp_hdr, 1),
+	SIM_EV(PART_EVT_MRPC_COMP_ASYNC, PART, part_cfg_regs,
+	       mrpc_comp_async_hdr, 2),
+	SIM_EV(PART_EVT_DYN_PART_BIND_COMP, PART, part_cfg_regs,
+	       dyn_binding_hdr, 3),
+	SIM_EV(PFF_EVT_AER_IN_P2P, PFF, pff_csr_regs, aer_in_p2p_hdr, 0),
+	SIM_EV(PFF_EVT_AER_IN_VEP, PFF, pff_csr_regs, aer_in_vep_hdr, 1),
+	SIM_EV(PFF_EVT_DPC, PFF, pff_csr_regs, dpc_hdr, 2),
+	SIM_EV(PFF_EVT_CTS, PFF, pff_csr_regs, cts_hdr, 3),
+	SIM_EV(PFF_EVT_HOTPLUG, PFF, pff_csr_regs, hotplug_hdr, 5),
+	SIM_EV(PFF_EVT_IER, PFF, pff_csr_regs, ier_hdr, 6),
+	SIM_EV(PFF_EVT_THRESH, PFF, pff_csr_regs, threshold_hdr, 7),
+	SIM_EV(PFF_EVT_POWER_MGMT, PFF, pff_csr_regs, power_mgmt_hdr, 8),
+	SIM_EV(PFF_EVT_TLP_THROTTLING, PFF, pff_csr_regs,
+	       tlp_throttling_hdr, 9),
+	SIM_EV(PFF_EVT_FORCE_SPEED, PFF, pff_csr_regs, force_speed_hdr, 10),
+	SIM_EV(PFF_EVT_CREDIT_TIMEOUT, PFF, pff_csr_regs,
+	       credit_timeout_hdr, 11),
+	SIM_EV(PFF_EVT_LINK_STATE, PFF, pff_csr_regs, link_state_hdr, 12),
+#undef SIM_EV
+};
+
+static uint32_t *sim_event_hdr(struct switchtec_sim *sdev,
+			       const struct sim_event *ev, int index)
+{
+	switch (ev->type) {
+	case SWITCHTEC_EVT_GLOBAL:
+		return (void *)((char *)&sdev->gas->sw_event + ev->offset);
+	case SWITCHTEC_EVT_PART:
+		return (void *)((char *)&sdev->gas->part_cfg[index] +
+				ev->offset);
+	case SWITCHTEC_EVT_PFF:
+		return (void *)((char *)&sdev->gas->pff_csr[index] +
+				ev->offset);
+	}
+
+	return NULL;
+}
+
+static void sim_event_summary_update(struct switchtec_sim *sdev,
+				     const struct sim_event *ev, int index,
+				     int occurred)
+{
+	struct switchtec_gas *gas = sdev->gas;
+	uint32_t *sum;
+
+	switch (ev->type) {
+	case SWITCHTEC_EVT_GLOBAL:
+		sum = &gas->sw_event.global_summary;
+		break;
+	case SWITCHTEC_EVT_PART:
+		sum = &gas->part_cfg[index].part_event_summary;
+		break;
+	case SWITCHTEC_EVT_PFF:
+		sum = &gas->pff_csr[index].pff_event_summary;
+		break;
+	default:
+		return;
+	}
+
+	if (occurred)
+		*sum |= 1 << ev->bit;
+	else
+		*sum &= ~(1 << ev->bit);
+
+	if (ev->type != SWITCHTEC_EVT_PART)
+		return;
+
+	if (*sum)
+		gas->sw_event.part_event_bitmap |= 1ULL << index;
+	else
+		gas->sw_event.part_event_bitmap &= ~(1ULL << index);
+}
+
+/* Called with the lock held */
+static void sim_raise_event(struct switchtec_sim *sdev,
+			    const struct sim_event *ev, int index)
+{
+	uint32_t *hdr = sim_event_hdr(sdev, ev, index);
+	uint32_t count = ((*hdr >> 5) + 1) & 0xFF;
+
+	*hdr = (*hdr & ~(0xFF << 5)) | (count << 5) |
+		SWITCHTEC_EVENT_OCCURRED;
+	sim_event_summary_update(sdev, ev, index, 1);
+}
+
+/*
+ * Find the event whose header lives at GAS offset @off, if any, so host
+ * writes to it can get write-1-to-clear semantics.
+ */
+static const struct sim_event *sim_find_event(struct switchtec_sim *sdev,
+					      size_t off, int *index)
+{
+	enum switchtec_event_type type;
+	size_t base, stride, limit;
+	int i;
+
+	if (off >= SWITCHTEC_GAS_SW_EVENT_OFFSET &&
+	    off < SWITCHTEC_GAS_SYS_INFO_OFFSET) {
+		type = SWITCHTEC_EVT_GLOBAL;
+		base = SWITCHTEC_GAS_SW_EVENT_OFFSET;
+		stride = sizeof(struct sw_event_regs);
+		limit = 1;
+	} else if (off >= SWITCHTEC_GAS_PART_CFG_OFFSET &&
+		   off < SWITCHTEC_GAS_PART_CFG_OFFSET +
+			 sizeof(sdev->gas->part_cfg)) {
+		type = SWITCHTEC_EVT_PART;
+		base = SWITCHTEC_GAS_PART_CFG_OFFSET;
+		stride = sizeof(struct part_cfg_regs);
+		limit = SWITCHTEC_MAX_PARTITIONS;
+	} else if (off >= SWITCHTEC_GAS_PFF_CSR_OFFSET &&
+		   off < sizeof(struct switchtec_gas)) {
+		type = SWITCHTEC_EVT_PFF;
+		base = SWITCHTEC_GAS_PFF_CSR_OFFSET;
+		stride = sizeof(struct pff_csr_regs);
+		limit = SWITCHTEC_MAX_PFF_CSR;
+	} else {
+		return NULL;
+	}
+
+	*index = (off - base) / stride;
+	if (*index >= limit)
+		return NULL;
+
+	off = (off - base) % stride;
+
+	for (i = 0; i < ARRAY_SIZE(sim_events); i++)
+		if (sim_events[i].type == type && sim_events[i].offset == off)
+			return &sim_events[i];
+
+	return NULL;
+}
+
+static void sim_close(struct switchtec_dev *dev)
+{
+	struct switchtec_sim *sdev = to_switchtec_sim(dev);
+
+	pthread_mutex_destroy(&sdev->lock);
+	free(sdev->flash);
+	free(sdev->gas);
+	free(sdev);
+}
+
+static gasptr_t sim_gas_map(struct switchtec_dev *dev, int writeable,
+			    size_t *map_size)
+{
+	if (map_size)
+		*map_size = dev->gas_map_size;
+
+	return dev->gas_map;
+}
+
+static void sim_gas_unmap(struct switchtec_dev *dev, gasptr_t map)
+{
+}
+
+/*
+ * MRPC command emulation. Each handler reads its input from the MRPC
+ * input window, fills in the output window and returns the value that
+ * will show up in the ret_value register.
+ */
+
+static int sim_echo(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const uint32_t *input = in;
+	uint32_t *output = out;
+
+	*output = ~*input;
+	return 0;
+}
+
+static int sim_lnkstat(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	struct {
+		uint8_t phys_port_id;
+		uint8_t par_id;
+		uint8_t log_port_id;
+		uint8_t stk_id;
+		uint8_t cfg_lnk_width;
+		uint8_t neg_lnk_width;
+		uint8_t usp_flag;
+		uint8_t linkup_linkrate;
+		uint16_t LTSSM;
+		uint16_t reserved;
+	} *ports = out;
+	int i;
+
+	for (i = 0; i < SWITCHTEC_MAX_PORTS; i++) {
+		if (i >= sdev->nr_ports) {
+			ports[i].stk_id = 0xFF;
+			continue;
+		}
+
+		ports[i].phys_port_id = i;
+		ports[i].par_id = 0;
+		ports[i].log_port_id = i;
+		ports[i].stk_id = ((i / 8) << 4) | (i % 8);
+		ports[i].cfg_lnk_width = i ? 4 : 16;
+		ports[i].neg_lnk_width = ports[i].cfg_lnk_width;
+		ports[i].usp_flag = !i;
+		ports[i].linkup_linkrate = 0x80 | 3;
+		ports[i].LTSSM = htole16(0x0103);
+	}
+
+	return 0;
+}
+
+static int sim_pmon_ev_setup(struct switchtec_sim *sdev, const void *in)
+{
+	const struct pmon_event_counter_setup *cmd = in;
+	struct sim_evcntr *cntr;
+	int i;
+
+	if (cmd->stack_id >= SWITCHTEC_MAX_STACKS ||
+	    cmd->counter_id + cmd->num_counters > SWITCHTEC_MAX_EVENT_COUNTERS)
+		return ERR_PARAM_INVALID;
+
+	for (i = 0; i < cmd->num_counters; i++) {
+		cntr = &sdev->evcntr[cmd->stack_id][cmd->counter_id + i];
+		cntr->mask = le32toh(cmd->counters[i].mask);
+		cntr->ieg = cmd->counters[i].ieg;
+		cntr->thresh = le32toh(cmd->counters[i].thresh);
+		cntr->base_us = now_us();
+	}
+
+	return 0;
+}
+
+static int sim_pmon_ev_get(struct switchtec_sim *sdev, const void *in,
+			   void *out, int setup)
+{
+	const struct pmon_event_counter_get *cmd = in;
+	struct pmon_event_counter_get_setup_result *sres = out;
+	struct pmon_event_counter_result *res = out;
+	struct sim_evcntr *cntr;
+	long long now = now_us();
+	int i;
+
+	if (cmd->stack_id >= SWITCHTEC_MAX_STACKS ||
+	    cmd->counter_id + cmd->num_counters > SWITCHTEC_MAX_EVENT_COUNTERS)
+		return ERR_PARAM_INVALID;
+
+	for (i = 0; i < cmd->num_counters; i++) {
+		cntr = &sdev->evcntr[cmd->stack_id][cmd->counter_id + i];
+
+		if (setup) {
+			sres[i].mask = htole32(cntr->mask);
+			sres[i].ieg = cntr->ieg;
+			sres[i].thresh = htole32(cntr->thresh);
+			continue;
+		}
+
+		/* An enabled counter sees one event per millisecond */
+		res[i].value = 0;
+		if (cntr->mask)
+			res[i].value = htole32((now - cntr->base_us) / 1000);
+		res[i].threshold = htole32(cntr->thresh);
+
+		if (cmd->read_clear)
+			cntr->base_us = now;
+	}
+
+	return 0;
+}
+
+static int sim_pmon_bw_get(struct switchtec_sim *sdev, const void *in,
+			   void *out)
+{
+	const struct pmon_bw_get *cmd = in;
+	struct switchtec_bwcntr_res *res = out;
+	long long now = now_us();
+	uint64_t t;
+	int i, id;
+
+	if (cmd->count > (SWITCHTEC_MRPC_PAYLOAD_SIZE / sizeof(*res)))
+		return ERR_PARAM_INVALID;
+
+	for (i = 0; i < cmd->count; i++) {
+		id = cmd->ports[i].id;
+		if (id >= sdev->nr_ports)
+			return ERR_PORT_INVALID;
+
+		/* Roughly 1GB/s out and 0.5GB/s in on every port */
+		t = now - sdev->bw_base_us[id];
+		res[i].time_us = htole64(t);
+		res[i].egress.posted = htole64(t * 800);
+		res[i].egress.comp = htole64(t * 150);
+		res[i].egress.nonposted = htole64(t * 50);
+		res[i].ingress.posted = htole64(t * 300);
+		res[i].ingress.comp = htole64(t * 150);
+		res[i].ingress.nonposted = htole64(t * 50);
+
+		if (cmd->ports[i].clear)
+			sdev->bw_base_us[id] = now;
+	}
+
+	return 0;
+}
+
+static int sim_pmon_bw_set(struct switchtec_sim *sdev, const void *in)
+{
+	const struct pmon_bw_set *cmd = in;
+	int i;
+
+	for (i = 0; i < cmd->count; i++)
+		if (cmd->ports[i].id >= sdev->nr_ports)
+			return ERR_PORT_INVALID;
+
+	return 0;
+}
+
+static int sim_pmon_lat_setup(struct switchtec_sim *sdev, const void *in)
+{
+	const struct pmon_lat_setup *cmd = in;
+	int i;
+
+	for (i = 0; i < cmd->count; i++) {
+		if (cmd->ports[i].egress >= sdev->nr_ports)
+			return ERR_PORT_INVALID;
+
+		sdev->lat_max_ns[cmd->ports[i].egress] = 0;
+	}
+
+	return 0;
+}
+
+static int sim_pmon_lat_get(struct switchtec_sim *sdev, const void *in,
+			    void *out)
+{
+	const struct pmon_lat_get *cmd = in;
+	struct pmon_lat_data *res = out;
+	uint16_t cur;
+	int i, id;
+
+	for (i = 0; i < cmd->count; i++) {
+		id = cmd->port_ids[i];
+		if (id >= sdev->nr_ports)
+			return ERR_PORT_INVALID;
+
+		cur = 350 + id * 5 + (now_us() % 64);
+		if (cur > sdev->lat_max_ns[id])
+			sdev->lat_max_ns[id] = cur;
+
+		res[i].cur_ns = htole16(cur);
+		res[i].max_ns = htole16(sdev->lat_max_ns[id]);
+
+		if (cmd->clear)
+			sdev->lat_max_ns[id] = 0;
+	}
+
+	return 0;
+}
+
+static int sim_pmon(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const uint8_t *sub_cmd_id = in;
+
+	switch (*sub_cmd_id) {
+	case MRPC_PMON_SETUP_EV_COUNTER:
+		return sim_pmon_ev_setup(sdev, in);
+	case MRPC_PMON_GET_EV_COUNTER:
+		return sim_pmon_ev_get(sdev, in, out, 0);
+	case MRPC_PMON_GET_EV_COUNTER_SETUP:
+		return sim_pmon_ev_get(sdev, in, out, 1);
+	case MRPC_PMON_GET_BW_COUNTER:
+		return sim_pmon_bw_get(sdev, in, out);
+	case MRPC_PMON_SET_BW_COUNTER:
+		return sim_pmon_bw_set(sdev, in);
+	case MRPC_PMON_SETUP_LAT_COUNTER:
+		return sim_pmon_lat_setup(sdev, in);
+	case MRPC_PMON_GET_LAT_COUNTER:
+		return sim_pmon_lat_get(sdev, in, out);
+	}
+
+	return ERR_SUBCMD_INVALID;
+}
+
+static void sim_write_footer(struct switchtec_sim *sdev, uint32_t addr,
+			     uint32_t len, uint32_t image_len,
+			     uint32_t version, uint32_t image_crc)
+{
+	struct switchtec_fw_footer ftr = {
+		.magic = "PMC",
+		.image_len = htole32(image_len),
+		.load_addr = htole32(addr),
+		.version = htole32(version),
+		.image_crc = htole32(image_crc),
+	};
+
+	memcpy(&sdev->flash[addr - SIM_FLASH_BASE + len - sizeof(ftr)],
+	       &ftr, sizeof(ftr));
+}
+
+static void sim_flash_partition(struct switchtec_sim *sdev, int cfg,
+				uint32_t *addr, uint32_t *len,
+				struct active_partition_info **active,
+				uint32_t *other)
+{
+	struct flash_info_regs *fi = &sdev->gas->flash_info;
+
+	if (cfg) {
+		*active = &fi->active_cfg;
+		*len = SIM_CFG_LEN;
+		*addr = fi->active_cfg.address == SIM_CFG0_ADDR ?
+			SIM_CFG0_ADDR : SIM_CFG1_ADDR;
+		*other = *addr == SIM_CFG0_ADDR ? SIM_CFG1_ADDR : SIM_CFG0_ADDR;
+	} else {
+		*active = &fi->active_img;
+		*len = SIM_IMG_LEN;
+		*addr = fi->active_img.address == SIM_IMG0_ADDR ?
+			SIM_IMG0_ADDR : SIM_IMG1_ADDR;
+		*other = *addr == SIM_IMG0_ADDR ? SIM_IMG1_ADDR : SIM_IMG0_ADDR;
+	}
+}
+
+static void sim_flash_toggle(struct switchtec_sim *sdev, int cfg)
+{
+	struct flash_info_regs *fi = &sdev->gas->flash_info;
+	struct active_partition_info *active;
+	uint32_t addr, len, other;
+
+	sim_flash_partition(sdev, cfg, &addr, &len, &active, &other);
+	active->address = other;
+
+	if (cfg)
+		fi->inactive_cfg.address = addr;
+	else
+		fi->inactive_img.address = addr;
+}
+
+static int sim_fwdnld_block(struct switchtec_sim *sdev, const void *in)
+{
+	const struct {
+		uint8_t subcmd;
+		uint8_t dont_activate;
+		uint8_t reserved[2];
+		uint32_t offset;
+		uint32_t img_length;
+		uint32_t blk_length;
+		uint8_t data[];
+	} *cmd = in;
+	struct active_partition_info *active;
+	uint32_t offset = le32toh(cmd->offset);
+	uint32_t img_len = le32toh(cmd->img_length);
+	uint32_t blk_len = le32toh(cmd->blk_length);
+	uint32_t addr, len, target;
+	int cfg;
+
+	if (blk_len > SWITCHTEC_MRPC_PAYLOAD_SIZE - sizeof(*cmd) ||
+	    offset + blk_len > img_len) {
+		sdev->dlstatus = SWITCHTEC_DLSTAT_LENGTH_INCORRECT;
+		return 0;
+	}
+
+	if (offset == 0) {
+		if (blk_len < sizeof(sdev->dl_hdr)) {
+			sdev->dlstatus = SWITCHTEC_DLSTAT_HEADER_INCORRECT;
+			return 0;
+		}
+
+		memcpy(&sdev->dl_hdr, cmd->data, sizeof(sdev->dl_hdr));
+
+		switch (le32toh(sdev->dl_hdr.type)) {
+		case SWITCHTEC_FW_TYPE_IMG0:
+		case SWITCHTEC_FW_TYPE_IMG1:
+			cfg = 0;
+			break;
+		case SWITCHTEC_FW_TYPE_DAT0:
+		case SWITCHTEC_FW_TYPE_DAT1:
+			cfg = 1;
+			break;
+		default:
+			sdev->dlstatus = SWITCHTEC_DLSTAT_HEADER_INCORRECT;
+			return 0;
+		}
+
+		sim_flash_partition(sdev, cfg, &addr, &len, &active, &target);
+		if (img_len > len - sizeof(struct switchtec_fw_footer)) {
+			sdev->dlstatus = SWITCHTEC_DLSTAT_LENGTH_INCORRECT;
+			return 0;
+		}
+
+		sdev->dl_addr = target;
+	} else if (sdev->dlstatus != SWITCHTEC_DLSTAT_INPROGRESS) {
+		sdev->dlstatus = SWITCHTEC_DLSTAT_OFFSET_INCORRECT;
+		return 0;
+	}
+
+	memcpy(&sdev->flash[sdev->dl_addr - SIM_FLASH_BASE + offset],
+	       cmd->data, blk_len);
+
+	if (offset + blk_len < img_len) {
+		sdev->dlstatus = SWITCHTEC_DLSTAT_INPROGRESS;
+		return 0;
+	}
+
+	cfg = sdev->dl_addr == SIM_CFG0_ADDR || sdev->dl_addr == SIM_CFG1_ADDR;
+	len = cfg ? SIM_CFG_LEN : SIM_IMG_LEN;
+	sim_write_footer(sdev, sdev->dl_addr, len, img_len,
+			 le32toh(sdev->dl_hdr.version),
+			 le32toh(sdev->dl_hdr.image_crc));
+
+	if (cmd->dont_activate) {
+		sdev->dlstatus = SWITCHTEC_DLSTAT_COMPLETES;
+		return 0;
+	}
+
+	sim_flash_toggle(sdev, cfg);
+	sdev->dlstatus = cfg ? SWITCHTEC_DLSTAT_SUCCESS_DATA_ACT :
+		SWITCHTEC_DLSTAT_SUCCESS_FIRM_ACT;
+
+	return 0;
+}
+
+static int sim_fwdnld(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const uint8_t *subcmd = in;
+	struct {
+		uint8_t dlstatus;
+		uint8_t bgstatus;
+		uint16_t reserved;
+	} *result = out;
+	const struct {
+		uint8_t subcmd;
+		uint8_t toggle_fw;
+		uint8_t toggle_cfg;
+	} *toggle = in;
+	const struct {
+		uint8_t subcmd;
+		uint8_t set_get;
+		uint8_t status;
+		uint8_t reserved;
+	} *boot_ro = in;
+
+	switch (*subcmd) {
+	case MRPC_FWDNLD_GET_STATUS:
+		result->dlstatus = sdev->dlstatus;
+		result->bgstatus = MRPC_BG_STAT_IDLE;
+		return 0;
+	case MRPC_FWDNLD_DOWNLOAD:
+		return sim_fwdnld_block(sdev, in);
+	case MRPC_FWDNLD_TOGGLE:
+		if (toggle->toggle_fw)
+			sim_flash_toggle(sdev, 0);
+		if (toggle->toggle_cfg)
+			sim_flash_toggle(sdev, 1);
+		return 0;
+	case MRPC_FWDNLD_BOOT_RO:
+		if (!boot_ro->set_get)
+			*(uint8_t *)out = sdev->boot_ro;
+		else
+			sdev->boot_ro = boot_ro->status;
+		return 0;
+	}
+
+	return ERR_SUBCMD_INVALID;
+}
+
+static int sim_multi_cfg(struct switchtec_sim *sdev, const void *in,
+			 void *out)
+{
+	const uint32_t *subcmd = in;
+	uint32_t *result = out;
+
+	/* Only the two regular configuration partitions are simulated */
+	switch (le32toh(*subcmd) & 0xFF) {
+	case MRPC_MULTI_CFG_SUPPORTED:
+	case MRPC_MULTI_CFG_COUNT:
+	case MRPC_MULTI_CFG_ACTIVE:
+		*result = 0;
+		return 0;
+	}
+
+	return ERR_PARAM_INVALID;
+}
+
+static int sim_rd_flash(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const struct {
+		uint32_t addr;
+		uint32_t length;
+	} *cmd = in;
+	uint32_t addr = le32toh(cmd->addr);
+	uint32_t len = le32toh(cmd->length);
+
+	if (len > SWITCHTEC_MRPC_PAYLOAD_SIZE || addr < SIM_FLASH_BASE ||
+	    addr - SIM_FLASH_BASE >= SIM_FLASH_SIZE ||
+	    len > SIM_FLASH_SIZE - (addr - SIM_FLASH_BASE))
+		return ERR_PARAM_INVALID;
+
+	memcpy(out, &sdev->flash[addr - SIM_FLASH_BASE], len);
+	return 0;
+}
+
+static int sim_log_a(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const struct log_a_retr *cmd = in;
+	struct log_a_retr_result *res = out;
+	uint32_t total, start, count, i;
+
+	total = cmd->sub_cmd_id == MRPC_FWLOGRD_RAM ?
+		SIM_LOG_A_RAM_ENTRIES : SIM_LOG_A_FLASH_ENTRIES;
+
+	start = le32toh(cmd->start);
+	if (start == -1)
+		start = 0;
+	if (start > total)
+		return ERR_PARAM_INVALID;
+
+	count = total - start;
+	if (count > ARRAY_SIZE(res->data))
+		count = ARRAY_SIZE(res->data);
+
+	res->hdr.sub_cmd_id = cmd->sub_cmd_id;
+	res->hdr.total = htole32(total);
+	res->hdr.count = htole32(count);
+	res->hdr.remain = htole32(total - start - count);
+	res->hdr.next_start = htole32(start + count);
+
+	for (i = 0; i < count; i++) {
+		memset(&res->data[i], 0, sizeof(res->data[i]));
+		res->data[i].data[0] = htole32(start + i);
+		res->data[i].data[1] = htole32((start + i) * 1000);
+	}
+
+	return 0;
+}
+
+static int sim_log_b(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const struct log_b_retr *cmd = in;
+	struct log_b_retr_result *res = out;
+	uint32_t total, offset, len, i;
+
+	switch (cmd->sub_cmd_id) {
+	case MRPC_FWLOGRD_MEMLOG:	total = 64 * 1024; break;
+	case MRPC_FWLOGRD_REGS:		total = 4 * 1024; break;
+	case MRPC_FWLOGRD_THRD_STACK:	total = 8 * 1024; break;
+	case MRPC_FWLOGRD_SYS_STACK:	total = 8 * 1024; break;
+	default:			total = 2 * 1024; break;
+	}
+
+	offset = le32toh(cmd->offset);
+	len = le32toh(cmd->length);
+	if (offset > total)
+		return ERR_PARAM_INVALID;
+
+	if (len > sizeof(res->data))
+		len = sizeof(res->data);
+	if (len > total - offset)
+		len = total - offset;
+
+	res->hdr.sub_cmd_id = cmd->sub_cmd_id;
+	res->hdr.length = htole32(len);
+	res->hdr.remain = htole32(total - offset - len);
+
+	for (i = 0; i < len; i++)
+		res->data[i] = (offset + i) ^ cmd->sub_cmd_id;
+
+	return 0;
+}
+
+static int sim_fwlogrd(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const uint8_t *sub_cmd_id = in;
+
+	switch (*sub_cmd_id) {
+	case MRPC_FWLOGRD_RAM:
+	case MRPC_FWLOGRD_FLASH:
+		return sim_log_a(sdev, in, out);
+	case MRPC_FWLOGRD_MEMLOG:
+	case MRPC_FWLOGRD_REGS:
+	case MRPC_FWLOGRD_THRD_STACK:
+	case MRPC_FWLOGRD_SYS_STACK:
+	case MRPC_FWLOGRD_THRD:
+		return sim_log_b(sdev, in, out);
+	}
+
+	return ERR_SUBCMD_INVALID;
+}
+
+static int sim_dietemp(struct switchtec_sim *sdev, const void *in, void *out)
+{
+	const uint32_t *sub_cmd_id = in;
+	uint32_t *temp = out;
+
+	switch (le32toh(*sub_cmd_id)) {
+	case MRPC_DIETEMP_SET_CLOCK:
+	case MRPC_DIETEMP_SET_MEAS:
+	case MRPC_DIETEMP_STOP:
+		return 0;
+	case MRPC_DIETEMP_GET:
+		*temp = htole32(SIM_DIE_TEMP);
+		return 0;
+	}
+
+	return ERR_SUBCMD_INVALID;
+}
+
+static int sim_mrpc_exec(struct switchtec_sim *sdev, uint32_t cmd)
+{
+	struct mrpc_regs *mrpc = &sdev->gas->mrpc;
+	const void *in = mrpc->input_data;
+	void *out = mrpc->output_data;
+
+	switch (cmd) {
+	case MRPC_ECHO:		return sim_echo(sdev, in, out);
+	case MRPC_LNKSTAT:	return sim_lnkstat(sdev, in, out);
+	case MRPC_PMON:		return sim_pmon(sdev, in, out);
+	case MRPC_FWDNLD:	return sim_fwdnld(sdev, in, out);
+	case MRPC_RD_FLASH:	return sim_rd_flash(sdev, in, out);
+	case MRPC_MULTI_CFG:	return sim_multi_cfg(sdev, in, out);
+	case MRPC_FWLOGRD:	return sim_fwlogrd(sdev, in, out);
+	case MRPC_DIETEMP:	return sim_dietemp(sdev, in, out);
+	}
+
+	return ERR_CMD_INVALID;
+}
+
+/*
+ * Writing the command register runs the command straight away but the
+ * status register keeps reporting INPROGRESS until the configured latency
+ * for that command has passed.
+ */
+static void sim_mrpc_start(struct switchtec_sim *sdev, uint32_t cmd)
+{
+	struct mrpc_regs *mrpc = &sdev->gas->mrpc;
+	unsigned lat;
+
+	cmd &= SWITCHTEC_CMD_MASK;
+	lat = cmd < SIM_NR_CMDS ? sdev->latency_us[cmd] :
+		SIM_DEFAULT_LATENCY_US;
+
+	mrpc->ret_value = htole32(sim_mrpc_exec(sdev, cmd));
+	mrpc->status = htole32(SWITCHTEC_MRPC_STATUS_INPROGRESS);
+	sdev->mrpc_done_us = now_us() + lat;
+}
+
+static void sim_mrpc_update(struct switchtec_sim *sdev)
+{
+	struct mrpc_regs *mrpc = &sdev->gas->mrpc;
+
+	if (le32toh(mrpc->status) != SWITCHTEC_MRPC_STATUS_INPROGRESS)
+		return;
+
+	if (now_us() < sdev->mrpc_done_us)
+		return;
+
+	mrpc->status = htole32(SWITCHTEC_MRPC_STATUS_DONE);
+
+	pthread_mutex_lock(&sdev->lock);
+	sim_raise_event(sdev, &sim_events[SWITCHTEC_PART_EVT_MRPC_COMP],
+			sdev->dev.partition);
+	pthread_mutex_unlock(&sdev->lock);
+}
+
+static size_t sim_gas_off(struct switchtec_dev *dev, const void __gas *addr)
+{
+	return (const char __gas *)addr - (const char __gas *)dev->gas_map;
+}
+
+static uint8_t sim_gas_read8(struct switchtec_dev *dev, uint8_t __gas *addr)
+{
+	return *(volatile uint8_t __force *)addr;
+}
+
+static uint16_t sim_gas_read16(struct switchtec_dev *dev,
+			       uint16_t __gas *addr)
+{
+	return *(volatile uint16_t __force *)addr;
+}
+
+static uint32_t sim_gas_read32(struct switchtec_dev *dev,
+			       uint32_t __gas *addr)
+{
+	struct switchtec_sim *sdev = to_switchtec_sim(dev);
+
+	if (addr == &dev->gas_map->mrpc.status)
+		sim_mrpc_update(sdev);
+
+	return *(volatile uint32_t __force *)addr;
+}
+
+static uint64_t sim_gas_read64(struct switchtec_dev *dev,
+			       uint64_t __gas *addr)
+{
+	return *(volatile uint64_t __force *)addr;
+}
+
+static void sim_gas_write8(struct switchtec_dev *dev, uint8_t val,
+			   uint8_t __gas *addr)
+{
+	*(volatile uint8_t __force *)addr = val;
+}
+
+static void sim_gas_write16(struct switchtec_dev *dev, uint16_t val,
+			    uint16_t __gas *addr)
+{
+	*(volatile uint16_t __force *)addr = val;
+}
+
+static void sim_gas_write32(struct switchtec_dev *dev, uint32_t val,
+			    uint32_t __gas *addr)
+{
+	struct switchtec_sim *sdev = to_switchtec_sim(dev);
+	const struct sim_event *ev;
+	uint32_t *hdr;
+	int index;
+
+	if (addr == &dev->gas_map->mrpc.cmd) {
+		*(volatile uint32_t __force *)addr = val;
+		sim_mrpc_start(sdev, le32toh(val));
+		return;
+	}
+
+	ev = sim_find_event(sdev, sim_gas_off(dev, addr), &index);
+	if (!ev) {
+		*(volatile uint32_t __force *)addr = val;
+		return;
+	}
+
+	/*
+	 * The occurred bit in event headers is write-1-to-clear, and
+	 * clearing it also resets the occurrence count.
+	 */
+	hdr = (uint32_t __force *)addr;
+	pthread_mutex_lock(&sdev->lock);
+
+	if (val & SWITCHTEC_EVENT_CLEAR) {
+		*hdr = val & ~(SWITCHTEC_EVENT_OCCURRED | (0xFF << 5));
+		sim_event_summary_update(sdev, ev, index, 0);
+	} else {
+		*hdr = (val & ~SWITCHTEC_EVENT_OCCURRED) |
+			(*hdr & SWITCHTEC_EVENT_OCCURRED);
+	}
+
+	pthread_mutex_unlock(&sdev->lock);
+}
+
+static void sim_gas_write64(struct switchtec_dev *dev, uint64_t val,
+			    uint64_t __gas *addr)
+{
+	*(volatile uint64_t __force *)addr = val;
+}
+
+static void sim_memcpy_to_gas(struct switchtec_dev *dev, void __gas *dest,
+			      const void *src, size_t n)
+{
+	memcpy((void __force *)dest, src, n);
+}
+
+static void sim_memcpy_from_gas(struct switchtec_dev *dev, void *dest,
+				const void __gas *src, size_t n)
+{
+	memcpy(dest, (const void __force *)src, n);
+}
+
+static ssize_t sim_write_from_gas(struct switchtec_dev *dev, int fd,
+				  const void __gas *src, size_t n)
+{
+	return write(fd, (const void __force *)src, n);
+}
+
+static const struct switchtec_ops sim_ops = {
+	.close = sim_close,
+	.gas_map = sim_gas_map,
+	.gas_unmap = sim_gas_unmap,
+
+	.cmd = gasop_cmd,
+	.cmdv = gasop_cmdv,
+	.cmd_submit = gasop_cmd_submit,
+	.cmd_poll = gasop_cmd_poll,
+	.cmd_complete = gasop_cmd_complete,
+	.get_device_id = gasop_get_device_id,
+	.get_fw_version = gasop_get_fw_version,
+	.pff_to_port = gasop_pff_to_port,
+	.port_to_pff = gasop_port_to_pff,
+	.part_pffs = gasop_part_pffs,
+	.flash_part = gasop_flash_part,
+	.event_summary = gasop_event_summary,
+	.event_ctl = gasop_event_ctl,
+	.event_wait_set = gasop_event_wait_set,
+
+	.gas_read8 = sim_gas_read8,
+	.gas_read16 = sim_gas_read16,
+	.gas_read32 = sim_gas_read32,
+	.gas_read64 = sim_gas_read64,
+	.gas_write8 = sim_gas_write8,
+	.gas_write16 = sim_gas_write16,
+	.gas_write32 = sim_gas_write32,
+	.gas_write64 = sim_gas_write64,
+	.memcpy_to_gas = sim_memcpy_to_gas,
+	.memcpy_from_gas = sim_memcpy_from_gas,
+	.write_from_gas = sim_write_from_gas,
+};
+
+static void sim_init_gas(struct switchtec_sim *sdev)
+{
+	struct switchtec_gas *gas = sdev->gas;
+	struct part_cfg_regs *pcfg = &gas->part_cfg[0];
+	struct flash_info_regs *fi = &gas->flash_info;
+	struct sys_info_regs *si = &gas->sys_info;
+	int i;
+
+	gas->top.partition_count = 1;
+	gas->top.partition_id = 0;
+	gas->top.pff_count = sdev->nr_ports + 1;
+	for (i = 0; i < sdev->nr_ports; i++)
+		gas->top.stack_valid[i / 8] = 1;
+
+	si->device_id = htole32(SIM_DEVICE_ID);
+	si->firmware_version = htole32(SIM_FW_VERSION);
+	si->cfg_running = htole16(SWITCHTEC_CFG0_RUNNING);
+	si->img_running = htole16(SWITCHTEC_IMG0_RUNNING);
+	memcpy(si->vendor_id, "MICROSEM", sizeof(si->vendor_id));
+	memcpy(si->product_id, "PFX 96XG3 SIM   ", sizeof(si->product_id));
+
+	fi->flash_length = htole32(SIM_FLASH_SIZE);
+	fi->img0.address = htole32(SIM_IMG0_ADDR);
+	fi->img0.length = htole32(SIM_IMG_LEN);
+	fi->img1.address = htole32(SIM_IMG1_ADDR);
+	fi->img1.length = htole32(SIM_IMG_LEN);
+	fi->cfg0.address = htole32(SIM_CFG0_ADDR);
+	fi->cfg0.length = htole32(SIM_CFG_LEN);
+	fi->cfg1.address = htole32(SIM_CFG1_ADDR);
+	fi->cfg1.length = htole32(SIM_CFG_LEN);
+	fi->nvlog.address = htole32(SIM_NVLOG_ADDR);
+	fi->nvlog.length = htole32(SIM_NVLOG_LEN);
+	fi->active_img.address = fi->img0.address;
+	fi->active_cfg.address = fi->cfg0.address;
+	fi->inactive_img.address = fi->img1.address;
+	fi->inactive_cfg.address = fi->cfg1.address;
+
+	sim_write_footer(sdev, SWITCHTEC_FLASH_BOOT_PART_START,
+			 SWITCHTEC_FLASH_PART_LEN, SWITCHTEC_FLASH_PART_LEN / 2,
+			 SIM_FW_VERSION, 0x01234567);
+	sim_write_footer(sdev, SWITCHTEC_FLASH_MAP0_PART_START,
+			 SWITCHTEC_FLASH_PART_LEN, SWITCHTEC_FLASH_PART_LEN / 2,
+			 SIM_FW_VERSION, 0x89abcdef);
+	sim_write_footer(sdev, SIM_IMG0_ADDR, SIM_IMG_LEN, SIM_IMG_LEN / 2,
+			 SIM_FW_VERSION, 0x12345678);
+	sim_write_footer(sdev, SIM_IMG1_ADDR, SIM_IMG_LEN, SIM_IMG_LEN / 2,
+			 SIM_FW_VERSION - 1, 0x23456789);
+	sim_write_footer(sdev, SIM_CFG0_ADDR, SIM_CFG_LEN, SIM_CFG_LEN / 2,
+			 SIM_FW_VERSION, 0x3456789a);
+	sim_write_footer(sdev, SIM_CFG1_ADDR, SIM_CFG_LEN, SIM_CFG_LEN / 2,
+			 SIM_FW_VERSION - 1, 0x456789ab);
+
+	/* Port 0 is the upstream port, the rest are downstream ports */
+	pcfg->port_cnt = htole32(sdev->nr_ports);
+	pcfg->usp_pff_inst_id = 0;
+	pcfg->vep_pff_inst_id = htole32(sdev->nr_ports);
+	for (i = 0; i < ARRAY_SIZE(pcfg->dsp_pff_inst_id); i++)
+		pcfg->dsp_pff_inst_id[i] = htole32(i + 1 < sdev->nr_ports ?
+						   i + 1 : 0xFFFFFFFF);
+
+	for (i = 0; i <= sdev->nr_ports; i++) {
+		gas->pff_csr[i].vendor_id = htole16(MICROSEMI_VENDOR_ID);
+		gas->pff_csr[i].device_id = htole16(SIM_DEVICE_ID);
+	}
+
+	gas->mrpc.status = htole32(SWITCHTEC_MRPC_STATUS_DONE);
+}
+
+/**
+ * @brief Open a simulated switchtec device
+ * @ingroup Device
+ * @param[in] nr_ports	Number of ports on the simulated switch
+ *	(1 to SWITCHTEC_MAX_PORTS), port 0 being the upstream port
+ * @return Switchtec device handle, NULL on failure
+ *
+ * The simulated device keeps a Global Address Space image in memory and
+ * emulates the ECHO, LNKSTAT, PMON, FWDNLD, RD_FLASH, FWLOGRD, DIETEMP and
+ * MULTI_CFG MRPC commands, which complete after a configurable delay (see
+ * switchtec_sim_set_latency()). It's intended for developing and
+ * benchmarking the library without hardware and may also be opened
+ * with switchtec_open() using the strings "sim" or "sim:<nr_ports>".
+ */
+struct switchtec_dev *switchtec_open_sim(int nr_ports)
+{
+	struct switchtec_sim *sdev;
+	int i;
+
+	if (nr_ports < 1 || nr_ports > SWITCHTEC_MAX_PORTS) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	sdev = calloc(1, sizeof(*sdev));
+	if (!sdev)
+		return NULL;
+
+	sdev->gas = calloc(1, sizeof(*sdev->gas));
+	if (!sdev->gas)
+		goto err_free;
+
+	sdev->flash = calloc(1, SIM_FLASH_SIZE);
+	if (!sdev->flash)
+		goto err_free_gas;
+
+	sdev->nr_ports = nr_ports;
+	for (i = 0; i < SIM_NR_CMDS; i++)
+		sdev->latency_us[i] = SIM_DEFAULT_LATENCY_US;
+	for (i = 0; i < SWITCHTEC_MAX_PORTS; i++)
+		sdev->bw_base_us[i] = now_us();
+
+	sim_init_gas(sdev);
+
+	pthread_mutex_init(&sdev->lock, NULL);
+
+	sdev->dev.gas_map = (gasptr_t __force)sdev->gas;
+	sdev->dev.gas_map_size = sizeof(*sdev->gas);
+	sdev->dev.ops = &sim_ops;
+	switchtec_cmdq_init(&sdev->dev);
+
+	gasop_set_partition_info(&sdev->dev);
+
+	return &sdev->dev;
+
+err_free_gas:
+	free(sdev->gas);
+err_free:
+	free(sdev);
+	return NULL;
+}
+
+/**
+ * @brief Set how long a simulated MRPC command takes to complete
+ * @ingroup Device
+ * @param[in] dev		Switchtec device handle from switchtec_open_sim()
+ * @param[in] cmd		MRPC command ID, or -1 for all commands
+ * @param[in] latency_us	Completion delay in microseconds
+ * @return 0 on success, negative on failure
+ *
+ * Every command takes 50us by default.
+ */
+int switchtec_sim_set_latency(struct switchtec_dev *dev, int cmd,
+			      unsigned latency_us)
+{
+	struct switchtec_sim *sdev = to_switchtec_sim(dev);
+	int i;
+
+	if (dev->ops != &sim_ops) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	if (cmd >= SIM_NR_CMDS || cmd < -1) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	if (cmd >= 0) {
+		sdev->latency_us[cmd] = latency_us;
+		return 0;
+	}
+
+	for (i = 0; i < SIM_NR_CMDS; i++)
+		sdev->latency_us[i] = latency_us;
+
+	return 0;
+}
+
+/**
+ * @brief Trigger an event on a simulated device
+ * @ingroup Device
+ * @param[in] dev	Switchtec device handle from switchtec_open_sim()
+ * @param[in] e		Event to trigger
+ * @param[in] index	Partition or port function index for partition
+ *	and PFF events (ignored for global events)
+ * @return 0 on success, negative on failure
+ *
+ * The event header and summary registers are updated just as the
+ * hardware would, so this may be used to exercise the event APIs.
+ */
+int switchtec_sim_raise_event(struct switchtec_dev *dev,
+			      enum switchtec_event_id e, int index)
+{
+	struct switchtec_sim *sdev = to_switchtec_sim(dev);
+	const struct sim_event *ev;
+
+	if (dev->ops != &sim_ops) {
+		errno = ENOTSUP;
+		return -errno;
+	}
+
+	if (e < 0 || e >= ARRAY_SIZE(sim_events)) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	ev = &sim_events[e];
+	if (ev->type == SWITCHTEC_EVT_GLOBAL)
+		index = 0;
+	else if (ev->type == SWITCHTEC_EVT_PART &&
+		 (index < 0 || index >= dev->partition_count))
+		index = -1;
+	else if (ev->type == SWITCHTEC_EVT_PFF &&
+		 (index < 0 || index > sdev->nr_ports))
+		index = -1;
+
+	if (index < 0) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	pthread_mutex_lock(&sdev->lock);
+	sim_raise_event(sdev, ev, index);
+	pthread_mutex_unlock(&sdev->lock);
+
+	return 0;
+}
+
+#undef __force
@@ -244,6 +244,7 @@ static BOOL map_gas(struct switchtec_windows *wdev)
 
 	wdev->dev.gas_map = (gasptr_t __force)map.gas;
 	wdev->dev.gas_map_size = map.length;
+	wdev->dev.gas_direct = 1;
 	return TRUE;
 }
 
@@ -254,6 +255,8 @@ static void unmap_gas(struct switchtec_windows *wdev)
 		.length = wdev->dev.gas_map_size,
 	};
 
+	wdev->dev.gas_direct = 0;
+
 	DeviceIoControl(wdev->hdl, IOCTL_SWITCHTEC_GAS_UNMAP, &map, sizeof(map),
 			NULL, 0, NULL, NULL);
 }
@@ -432,6 +435,7 @@ static const struct switchtec_ops windows_ops = {
 	.get_fw_version = gasop_get_fw_version,
 	.pff_to_port = gasop_pff_to_port,
 	.port_to_pff = gasop_port_to_pff,
+	.part_pffs = gasop_part_pffs,
 	.flash_part = gasop_flash_part,
 	.event_summary = gasop_event_summary,
 	.event_ctl = gasop_event_ctl,
@@ -458,7 +462,7 @@ struct switchtec_dev *switchtec_open_by_path(const char *path)
 	if (sscanf(path, "/dev/switchtec%d", &idx) == 1)
 		return switchtec_open_by_index(idx);
 
-	wdev = malloc(sizeof(*wdev));
+	wdev = calloc(1, sizeof(*wdev));
 	if (!wdev)
 		return NULL;
 
@@ -476,6 +480,7 @@ struct switchtec_dev *switchtec_open_by_path(const char *path)
 		goto err_close;
 
 	wdev->dev.ops = &windows_ops;
+	switchtec_cmdq_init(&wdev->dev);
 
 	gasop_set_partition_info(&wdev->dev);
 
@@ -580,10 +585,42 @@ struct switchtec_dev *switchtec_open_i2c_by_adapter(int adapter, int i2c_addr)
 	return NULL;
 }
 
+int switchtec_i2c_get_info(struct switchtec_dev *dev,
+			   struct switchtec_i2c_info *info)
+{
+	errno = ENOTSUP;
+	return -errno;
+}
+
+int switchtec_i2c_set_write_window(struct switchtec_dev *dev, int window)
+{
+	errno = ENOTSUP;
+	return -errno;
+}
+
 struct switchtec_dev *switchtec_open_uart(int fd)
 {
 	errno = ENOTSUP;
 	return NULL;
 }
 
+struct switchtec_dev *switchtec_open_uart_baud(int fd, int baud)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+struct switchtec_dev *switchtec_open_uart_by_path(const char *path,
+						  int baud)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+int switchtec_uart_get_baud(struct switchtec_dev *dev)
+{
+	errno = ENOTSUP;
+	return -errno;
+}
+
 #endif
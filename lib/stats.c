@@ -0,0 +1,213 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Per-handle MRPC command statistics
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+
+#include "switchtec/switchtec.h"
+#include "switchtec/mrpc.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @defgroup Stats MRPC Statistics
+ * @brief Count and time the MRPC commands issued on a handle
+ *
+ * Every command issued through a handle, whether with switchtec_cmd() or
+ * the asynchronous interface, is counted against its command and
+ * sub-command along with the bytes transferred, the errors returned and
+ * a log2 latency histogram. Recording happens in the thread that owns
+ * the MRPC at the time so it costs two clock reads and no extra locking.
+ * @{
+ */
+
+uint64_t switchtec_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Nearly every MRPC command takes a sub-command in the first byte of
+ * its payload; these are the exceptions.
+ */
+int switchtec_stats_subcmd(uint32_t cmd,
+			   const struct switchtec_iovec *payload,
+			   int payload_cnt)
+{
+	int i;
+
+	switch (cmd & SWITCHTEC_CMD_MASK) {
+	case MRPC_ECHO:
+	case MRPC_LNKSTAT:
+	case MRPC_RD_FLASH:
+		return -1;
+	}
+
+	for (i = 0; i < payload_cnt; i++)
+		if (payload[i].iov_len)
+			return *(uint8_t *)payload[i].iov_base;
+
+	return -1;
+}
+
+static int stats_bucket(uint64_t ns)
+{
+	int b = 0;
+
+	while (ns >>= 1)
+		b++;
+
+	if (b >= SWITCHTEC_STATS_HIST_BUCKETS)
+		b = SWITCHTEC_STATS_HIST_BUCKETS - 1;
+
+	return b;
+}
+
+static void stats_add(struct switchtec_cmd_stats *s, size_t payload_len,
+		      size_t resp_len, int ret, uint64_t elapsed_ns,
+		      int bucket)
+{
+	s->count++;
+	if (ret)
+		s->errors++;
+	s->bytes_in += payload_len;
+	s->bytes_out += resp_len;
+	s->total_ns += elapsed_ns;
+	if (elapsed_ns > s->max_ns)
+		s->max_ns = elapsed_ns;
+	s->hist[bucket]++;
+}
+
+/*
+ * Must be called by the thread that owns the MRPC: the queue dispatcher
+ * or the submitter of an async command.
+ */
+void switchtec_stats_record(struct switchtec_dev *dev, uint32_t cmd,
+			    int subcmd, size_t payload_len, size_t resp_len,
+			    int ret, uint64_t elapsed_ns)
+{
+	struct switchtec_stats *st = &dev->stats;
+	struct switchtec_cmd_stats *s;
+	int bucket = stats_bucket(elapsed_ns);
+	unsigned i, n;
+
+	cmd &= SWITCHTEC_CMD_MASK;
+
+	stats_add(&st->total, payload_len, resp_len, ret, elapsed_ns, bucket);
+
+	/* Open addressed on (cmd, subcmd); a zero count marks a free slot */
+	i = (cmd * 31 + subcmd + 1) % SWITCHTEC_STATS_MAX_CMDS;
+	for (n = 0; n < SWITCHTEC_STATS_MAX_CMDS; n++) {
+		s = &st->cmds[i];
+
+		if (!s->count) {
+			s->cmd = cmd;
+			s->subcmd = subcmd;
+			st->nr_cmds++;
+			break;
+		}
+
+		if (s->cmd == cmd && s->subcmd == subcmd)
+			break;
+
+		i = (i + 1) % SWITCHTEC_STATS_MAX_CMDS;
+	}
+
+	if (n == SWITCHTEC_STATS_MAX_CMDS) {
+		st->untracked++;
+		return;
+	}
+
+	stats_add(s, payload_len, resp_len, ret, elapsed_ns, bucket);
+}
+
+static int stats_cmp(const void *a, const void *b)
+{
+	const struct switchtec_cmd_stats *x = a;
+	const struct switchtec_cmd_stats *y = b;
+
+	if (x->cmd != y->cmd)
+		return x->cmd - y->cmd;
+
+	return x->subcmd - y->subcmd;
+}
+
+/**
+ * @brief Retrieve the MRPC statistics for a handle
+ * @param[in]  dev	Switchtec device handle
+ * @param[out] stats	Statistics since the handle was opened or
+ *			switchtec_stats_reset() was last called
+ * @return 0 on success, negative on failure
+ *
+ * The first stats->nr_cmds entries of stats->cmds are filled in, sorted
+ * by command and sub-command. This waits for any command in flight on
+ * another thread to finish so the snapshot is consistent.
+ */
+int switchtec_stats_get(struct switchtec_dev *dev,
+			struct switchtec_stats *stats)
+{
+	int i, n = 0;
+
+	switchtec_cmdq_pause(dev);
+	*stats = dev->stats;
+	switchtec_cmdq_resume(dev);
+
+	for (i = 0; i < SWITCHTEC_STATS_MAX_CMDS; i++)
+		if (stats->cmds[i].count)
+			stats->cmds[n++] = stats->cmds[i];
+
+	memset(&stats->cmds[n], 0, (SWITCHTEC_STATS_MAX_CMDS - n) *
+	       sizeof(stats->cmds[0]));
+	qsort(stats->cmds, n, sizeof(stats->cmds[0]), stats_cmp);
+
+	stats->nr_cmds = n;
+	stats->total.cmd = -1;
+	stats->total.subcmd = -1;
+
+	return 0;
+}
+
+/**
+ * @brief Clear the MRPC statistics for a handle
+ * @param[in]  dev	Switchtec device handle
+ */
+void switchtec_stats_reset(struct switchtec_dev *dev)
+{
+	switchtec_cmdq_pause(dev);
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	switchtec_cmdq_resume(dev);
+}
+
+/**@}*/
@@ -41,6 +41,8 @@
 #include <unistd.h>
 #include <errno.h>
 
+#define SWITCHTEC_SIM_DEFAULT_PORTS 16
+
 /**
  * @defgroup Device Switchtec Management
  * @brief Functions to list, open and perform basic operations on Switchtec devices
@@ -163,6 +165,11 @@ static int set_gen_variant(struct switchtec_dev * dev)
  *   * An I2C device delimited with a colon (/dev/i2c-1:0x20)
  *     (must start with a / so that it is distinguishable from a BDF)
  *   * A UART device (/dev/ttyUSB0)
+ *   * A UART device at a given baud rate (/dev/ttyUSB0@921600)
+ *   * A UART device at the fastest rate the console answers on
+ *     (/dev/ttyUSB0@auto)
+ *   * A simulated device with the default number of ports (sim)
+ *   * A simulated device with a given number of ports (sim:8)
  */
 struct switchtec_dev *switchtec_open(const char *device)
 {
@@ -170,11 +177,33 @@ struct switchtec_dev *switchtec_open(const char *device)
 	int domain = 0;
 	int bus, dev, func;
 	char path[PATH_MAX];
+	char rate[5];
 	char *endptr;
 	struct switchtec_dev *ret;
 
+	if (!strcmp(device, "sim")) {
+		ret = switchtec_open_sim(SWITCHTEC_SIM_DEFAULT_PORTS);
+		goto found;
+	}
+
+	if (sscanf(device, "sim:%i", &idx) == 1) {
+		ret = switchtec_open_sim(idx);
+		goto found;
+	}
+
+	if (sscanf(device, "%2049[^@]@%4s", path, rate) == 2 &&
+	    !strcmp(rate, "auto")) {
+		ret = switchtec_open_uart_by_path(path,
+						  SWITCHTEC_UART_BAUD_AUTO);
+		goto found;
+	}
+
 	if (sscanf(device, "%2049[^@]@%i", path, &dev) == 2) {
-		ret = switchtec_open_i2c(path, dev);
+		/* Anything too big for a 7-bit I2C address is a baud rate */
+		if (dev > 0x7f)
+			ret = switchtec_open_uart_by_path(path, dev);
+		else
+			ret = switchtec_open_i2c(path, dev);
 		goto found;
 	}
 
@@ -220,10 +249,12 @@ struct switchtec_dev *switchtec_open(const char *device)
 	return NULL;
 
 found:
-	if (ret)
-		snprintf(ret->name, sizeof(ret->name), "%s", device);
-	else
+	if (!ret) {
 		errno = ENODEV;
+		return NULL;
+	}
+
+	snprintf(ret->name, sizeof(ret->name), "%s", device);
 
 	if (set_gen_variant(ret))
 		return NULL;
@@ -299,6 +330,32 @@ int switchtec_set_pax_id(struct switchtec_dev *dev, int pax_id)
 	return 0;
 }
 
+/**
+ * @brief Select how MRPC command completions are waited for
+ * @param[in] dev	Switchtec device handle
+ * @param[in] policy	Polling policy to use for subsequent commands
+ * @return 0 on success, negative on failure
+ *
+ * This only has an effect on platforms that poll the MRPC status
+ * register directly (I2C and UART).
+ */
+int switchtec_set_mrpc_poll_policy(struct switchtec_dev *dev,
+				   enum switchtec_mrpc_poll_policy policy)
+{
+	switch (policy) {
+	case SWITCHTEC_MRPC_POLL_BALANCED:
+	case SWITCHTEC_MRPC_POLL_LATENCY:
+	case SWITCHTEC_MRPC_POLL_LOW_CPU:
+		break;
+	default:
+		errno = EINVAL;
+		return -errno;
+	}
+
+	dev->mrpc_poll_policy = policy;
+	return 0;
+}
+
 static const char *ltssm_str(int ltssm, int show_minor)
 {
 	if (!show_minor)
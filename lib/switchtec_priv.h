@@ -31,8 +31,55 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <pthread.h>
+
+#define MRPC_LAT_TBL_SIZE 128
 
 struct switchtec_dev;
+struct switchtec_cmd_req;
+struct switchtec_cache;
+struct gas_read_req;
+struct gasop_rcache;
+struct switchtec_pff_map;
+
+/*
+ * The port function instance IDs assigned to one partition, as laid out
+ * in its part_cfg registers.
+ */
+struct switchtec_part_pffs {
+	uint32_t usp;
+	uint32_t vep;
+	uint32_t dsp[47];
+};
+
+/*
+ * Per-handle MRPC command queue. Callers on any thread enqueue their
+ * request and the first one to find the MRPC idle becomes the dispatcher,
+ * issuing everything queued back-to-back before handing over. Asynchronous
+ * commands take exclusive ownership of the MRPC between submit and
+ * complete.
+ */
+struct switchtec_cmdq {
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
+	struct switchtec_cmd_req *head;
+	struct switchtec_cmd_req **tail;
+	int idle_waiters;
+	int busy;
+	int async;
+	pthread_t owner;
+
+	/* Bounce buffers for backends without a cmdv op */
+	uint8_t *flat_buf;
+};
+
+/* An async command being timed between submit and complete */
+struct switchtec_stats_pending {
+	uint32_t cmd;
+	int subcmd;
+	size_t payload_len;
+	uint64_t start_ns;
+};
 
 struct switchtec_ops {
 	void (*close)(struct switchtec_dev *dev);
@@ -42,6 +89,15 @@ struct switchtec_ops {
 	int (*cmd)(struct switchtec_dev *dev,  uint32_t cmd,
 		   const void *payload, size_t payload_len, void *resp,
 		   size_t resp_len);
+	int (*cmdv)(struct switchtec_dev *dev, uint32_t cmd,
+		    const struct switchtec_iovec *payload, int payload_cnt,
+		    const struct switchtec_iovec *resp, int resp_cnt);
+	int (*cmd_submit)(struct switchtec_dev *dev, uint32_t cmd,
+			  const void *payload, size_t payload_len);
+	int (*cmd_poll)(struct switchtec_dev *dev, int timeout_ms);
+	int (*cmd_complete)(struct switchtec_dev *dev, void *resp,
+			    size_t resp_len);
+	int (*cmd_fd)(struct switchtec_dev *dev);
 	int (*get_devices)(struct switchtec_dev *dev,
 			   struct switchtec_status *status,
 			   int ports);
@@ -49,6 +105,8 @@ struct switchtec_ops {
 			   int *partition, int *port);
 	int (*port_to_pff)(struct switchtec_dev *dev, int partition,
 			   int port, int *pff);
+	int (*part_pffs)(struct switchtec_dev *dev,
+			 struct switchtec_part_pffs *parts, int nr_parts);
 	gasptr_t (*gas_map)(struct switchtec_dev *dev, int writeable,
 			    size_t *map_size);
 	void (*gas_unmap)(struct switchtec_dev *dev, gasptr_t map);
@@ -62,10 +120,11 @@ struct switchtec_ops {
 			 int index, int flags,
 			 uint32_t data[5]);
 	int (*event_wait)(struct switchtec_dev *dev, int timeout_ms);
-	int (*event_wait_for)(struct switchtec_dev *dev,
-			      enum switchtec_event_id e, int index,
+	int (*event_fd)(struct switchtec_dev *dev);
+	int (*event_wait_set)(struct switchtec_dev *dev,
+			      struct switchtec_event_summary *set,
 			      struct switchtec_event_summary *res,
-			      int timeout_ms);
+			      int latency_ms, int timeout_ms);
 
 	uint8_t (*gas_read8)(struct switchtec_dev *dev, uint8_t __gas *addr);
 	uint16_t (*gas_read16)(struct switchtec_dev *dev, uint16_t __gas *addr);
@@ -87,6 +146,9 @@ struct switchtec_ops {
 				const void __gas *src, size_t n);
 	ssize_t (*write_from_gas)(struct switchtec_dev *dev, int fd,
 				  const void __gas *src, size_t n);
+	void (*gas_read_batch)(struct switchtec_dev *dev,
+			       const struct gas_read_req *reqs, size_t n);
+	int (*gas_readahead)(struct switchtec_dev *dev, int enable);
 };
 
 struct switchtec_dev {
@@ -95,10 +157,27 @@ struct switchtec_dev {
 	enum switchtec_variant var;
 	int pax_id;
 	int partition, partition_count;
+	int pff_probed, pff_count, pff_csr_count;
 	char name[PATH_MAX];
 
 	gasptr_t gas_map;
 	size_t gas_map_size;
+	/* Set while gas_map may be accessed with plain loads and stores */
+	int gas_direct;
+
+	struct switchtec_cmdq cmdq;
+
+	enum switchtec_mrpc_poll_policy mrpc_poll_policy;
+	unsigned mrpc_lat_us[MRPC_LAT_TBL_SIZE];
+	uint32_t mrpc_cmd;
+	long long mrpc_submit_us;
+
+	struct switchtec_stats stats;
+	struct switchtec_stats_pending stats_async;
+
+	struct switchtec_cache *cache;
+	struct gasop_rcache *rcache;
+	struct switchtec_pff_map *pff_map;
 
 	const struct switchtec_ops *ops;
 };
@@ -112,6 +191,66 @@ static inline void version_to_string(uint32_t version, char *buf, size_t buflen)
 	snprintf(buf, buflen, "%x.%02x B%03X", major, minor, build);
 }
 
+static inline size_t iov_total_len(const struct switchtec_iovec *iov,
+				   int cnt)
+{
+	size_t len = 0;
+
+	while (cnt--)
+		len += iov++->iov_len;
+
+	return len;
+}
+
 const char *platform_strerror();
 
+void switchtec_cmdq_init(struct switchtec_dev *dev);
+void switchtec_cmdq_destroy(struct switchtec_dev *dev);
+int switchtec_cmdq_exec(struct switchtec_dev *dev, uint32_t cmd,
+			const struct switchtec_iovec *payload,
+			int payload_cnt,
+			const struct switchtec_iovec *resp, int resp_cnt);
+int switchtec_cmdq_acquire(struct switchtec_dev *dev);
+int switchtec_cmdq_owned(struct switchtec_dev *dev);
+void switchtec_cmdq_release(struct switchtec_dev *dev);
+void switchtec_cmdq_pause(struct switchtec_dev *dev);
+void switchtec_cmdq_resume(struct switchtec_dev *dev);
+
+uint64_t switchtec_stats_now(void);
+int switchtec_stats_subcmd(uint32_t cmd,
+			   const struct switchtec_iovec *payload,
+			   int payload_cnt);
+void switchtec_stats_record(struct switchtec_dev *dev, uint32_t cmd,
+			    int subcmd, size_t payload_len, size_t resp_len,
+			    int ret, uint64_t elapsed_ns);
+
+int switchtec_cache_mrpc_lookup(struct switchtec_dev *dev, uint32_t cmd,
+				const struct switchtec_iovec *payload,
+				int payload_cnt,
+				const struct switchtec_iovec *resp,
+				int resp_cnt, unsigned *gen);
+void switchtec_cache_mrpc_store(struct switchtec_dev *dev, uint32_t cmd,
+				const struct switchtec_iovec *payload,
+				int payload_cnt,
+				const struct switchtec_iovec *resp,
+				int resp_cnt, int ret, unsigned gen);
+void switchtec_cache_mrpc_done(struct switchtec_dev *dev, uint32_t cmd,
+			       int subcmd);
+int switchtec_cache_flash_part(struct switchtec_dev *dev,
+			       struct switchtec_fw_image_info *info,
+			       enum switchtec_fw_image_type part);
+int switchtec_cache_get_fw_version(struct switchtec_dev *dev, char *buf,
+				   size_t buflen);
+void switchtec_cache_events(struct switchtec_dev *dev,
+			    struct switchtec_event_summary *sum);
+
+void switchtec_pff_map_free(struct switchtec_dev *dev);
+int switchtec_pff_map_to_port(struct switchtec_dev *dev, int pff,
+			      int *partition, int *port);
+int switchtec_pff_map_to_pff(struct switchtec_dev *dev, int partition,
+			     int port, int *pff);
+
+void switchtec_journal_push(struct switchtec_journal *journal,
+			    const struct switchtec_event_record *rec);
+
 #endif